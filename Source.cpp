@@ -5,8 +5,22 @@
 #include <unordered_map>
 #include <array>
 #include <memory_resource>
+#include <thread>
 #include <cstdlib> // for std::byte
 #include "tracknew.hpp"
+#include "arena.hpp"
+#include "fallbackbuffer.hpp"
+#include "scratchstack.hpp"
+#include "staticarena.hpp"
+#include "tracker.hpp"
+#include "compose.hpp"
+#include "chainspec.hpp"
+#include "locality.hpp"
+#include "osstats.hpp"
+#include "runner.hpp"
+#include "introspect.hpp"
+#include "budget.hpp"
+#include "threaddefault.hpp"
 
 #pragma region Monotonic Memory Resource
 void whyRegularAllocationBad() {
@@ -97,6 +111,89 @@ void reUsingMemoryPools() {
 	// restore old default memory resource as default:
 	std::pmr::set_default_resource(old);
 }
+
+// set_default_resource() above switches the default of every thread at
+// once. Each worker can have its own instead, the in-tree resources and
+// helpers take get_thread_default() as their default upstream:
+void perThreadDefaults() {
+	auto worker = [](const char* name) {
+		Arena arena{ 10000 };
+		scoped_default_resource guard{ &arena };   // this thread only
+		Tracker track{ name };                     // upstream: the arena
+		std::pmr::vector<std::pmr::string> coll{ &track };
+		for (int i = 0; i < 100; ++i) {
+			coll.emplace_back("just a non-SSO string");
+		}
+		printStats(arena.stats(), name);
+	};
+	std::thread t1{ worker, "worker1: " };
+	t1.join();   // one after the other, just to keep the output apart
+	std::thread t2{ worker, "worker2: " };
+	t2.join();
+}
+
+// Instead of constructing a new monotonic_buffer_resource for every round,
+// an Arena can remember a position and jump back to it. Everything allocated
+// after the mark is freed at once, everything before it stays valid.
+void reUsingArenaMarkers() {
+	std::array<std::byte, 200000> buf;
+	Arena arena{ buf.data(), buf.size() };
+
+	// allocated once and kept for all rounds:
+	std::pmr::vector<std::pmr::string> names{ &arena };
+	names.emplace_back("just a non-SSO string");
+
+	for (int num : {1000, 2000, 3000, 4000, 5000}) {
+		std::cout << "-- check with  " << num << " elements\n";
+		TrackNew::reset();
+
+		Arena::Scope round{ arena }; // rewinds at the end of the round
+		std::pmr::vector<std::pmr::string> col{ &arena };
+
+		for (int i = 0; i < num; ++i) {
+			col.emplace_back("just a non-SSO string");
+		}
+
+		TrackNew::status();
+	}
+	std::cout << "kept: " << names.front() << '\n';
+}
+
+// Big buffers on the call stack risk a stack overflow. The scratch stack
+// of the thread is allocated once (on first use) and then hands out
+// temporaries just as cheaply, a Scope pops them when it ends.
+void scratchTemporaries() {
+	for (int num : {1000, 2000, 3000}) {
+		TrackNew::reset();
+		ScratchStack::Scope frame;
+
+		std::pmr::vector<std::pmr::string> coll{ &ScratchStack::local() };
+		for (int i = 0; i < num; ++i) {
+			coll.emplace_back("just a non-SSO string");
+		}
+
+		TrackNew::status(); // only the first round allocates the region
+	}
+}
+
+// StaticArena is buffer and monotonic resource in one object. Containers
+// use it as a memory_resource, code that knows its type can call the
+// non-virtual allocate() directly.
+void staticArenas() {
+	TrackNew::reset();
+
+	StaticArena<200000> arena;
+	std::pmr::vector<std::pmr::string> coll{ &arena };
+	for (int i = 0; i < 1000; ++i) {
+		coll.emplace_back("just a non-SSO string");
+	}
+
+	int* ints = static_cast<int*>(arena.allocate(100 * sizeof(int), alignof(int)));
+	ints[0] = 42;
+
+	TrackNew::status();
+	std::cout << arena.size() << " of " << arena.capacity() << " Bytes used\n";
+}
 #pragma endregion
 
 #pragma region Synchronized Memory Pools
@@ -123,13 +220,9 @@ void exampleSyncPoolBadImpl() {
 		coll.emplace(i, s);
 	}
 
-	// print element distance:
-	for (const auto& elem : coll) {
-		static long long lastVal = 0;
-		long long val = reinterpret_cast<long long>(&elem);
-		std::cout << "diff: " << (val - lastVal) << '\n';
-		lastVal = val;
-	}
+	// print how far apart the elements are (bench/locality.cpp measures
+	// what that means for traversals and lookups):
+	distanceHistogram(coll).print();
 }
 
 /*
@@ -168,13 +261,9 @@ void betterExampleSyncPool() {
 	*/
 	std::cout << "Max blocks per chunk: " << pool.options().max_blocks_per_chunk << '\n';
 
-	// print element distances:
-	for (const auto& elem : coll) {
-		static long long lastVal = 0;
-		long long val = reinterpret_cast<long long>(&elem);
-		std::cout << "diff: " << (val - lastVal) << '\n';
-		lastVal = val;
-	}
+	// print how far apart the elements are (bench/locality.cpp measures
+	// what that means for traversals and lookups):
+	distanceHistogram(coll).print();
 }
 #pragma endregion
 
@@ -217,6 +306,22 @@ void chainMemRes() {
 	} // deallocations are given back to the pool, but not deallocated
 	// so far nothing was deallocated
 } // deallocates all allocated memory
+
+// The chain put together at compile time: the pool calls the monotonic
+// arena directly instead of through the vtable, only the chain as a whole
+// is a memory_resource. Unlike the synchronized_pool_resource above it is
+// single-threaded, compose::pool is the unsynchronized Pool.
+void chainAtCompileTime() {
+	compose::chain<compose::pool<>, compose::monotonic<10000>> pool;
+
+	for (int j = 0; j < 100; ++j) {
+		std::pmr::vector<std::pmr::string> coll{ &pool };
+		for (int i = 0; i < 100; i++)
+		{
+			coll.emplace_back("just a non-SSO string");
+		}
+	}
+}
 #pragma endregion
 
 #pragma region Null_Memory_Resource
@@ -246,53 +351,227 @@ void exampleNMR() {
 	}
 	std::cout << "size: " << coll.size() << '\n';
 }
+
+// null_memory_resource() is all or nothing, budgets admit requests as long
+// as they fit: here two requests of a subsystem with 16 KB, one failing
+// fast when over its 8 KB, one falling back on what the subsystem has left.
+void admissionControl() {
+	BudgetResource subsystem{ 16 * 1024 };
+	BudgetResource strict{ 8 * 1024, &subsystem };
+	BudgetResource lenient{ 8 * 1024, BudgetResource::OverBudget::fallback, &subsystem };
+
+	std::pmr::vector<std::pmr::string> coll1{ &strict };
+	std::pmr::vector<std::pmr::string> coll2{ &lenient };
+	try {
+		for (int i = 0; i < 1000; ++i) {
+			coll1.emplace_back("just a non-SSO string");
+		}
+	}
+	catch (const std::bad_alloc&) {
+		std::cout << "strict: full after " << coll1.size() << " strings, "
+			<< strict.rejected() << " rejected\n";
+	}
+	try {
+		for (int i = 0; i < 1000; ++i) {
+			coll2.emplace_back("just a non-SSO string");
+		}
+	}
+	catch (const std::bad_alloc&) {
+		std::cout << "lenient: the subsystem is full after " << coll2.size() << " strings, "
+			<< lenient.fallbackCount() << " beyond its own budget\n";
+	}
+	std::cout << "subsystem: " << subsystem.used() << " of " << subsystem.limit()
+		<< " bytes used\n";
+}
+
+// The same without the exception: memory that does not fit into the stack
+// buffer comes from the heap instead, and the buffer tells how big it
+// should have been, so the next buffer can be sized accordingly.
+void exampleFallback() {
+	static BufferSizeHint hint;   // outlives the buffers
+
+	std::array<std::byte, 200000> buf;
+	{
+		FallbackBuffer pool{ buf.data(), buf.size(), hint };
+		std::pmr::unordered_map<long, std::pmr::string> coll{ &pool };
+		for (int i = 0; i < 5000; ++i) {
+			std::string a{ "Customer" + std::to_string(i) };
+			coll.emplace(i, a);
+		}
+		std::cout << "size: " << coll.size() << '\n';
+		pool.status();
+		if (pool.overflows() > 0) {
+			std::cout << "first overflow at call " << pool.firstOverflow().call
+				<< " asking for " << pool.firstOverflow().bytes << " Bytes\n";
+		}
+	}
+	std::cout << "next buffer should have " << hint.size << " Bytes\n";
+}
 #pragma endregion
 
 #pragma region Custom_Memory_Resources
-class Tracker : public std::pmr::memory_resource
-{
-private:
-	std::pmr::memory_resource* upstream;
-	std::string prefix{};
-
-public:
-	// we wrap the passed or default resource
-	explicit Tracker(std::pmr::memory_resource* us
-		= std::pmr::get_default_resource())
-		: upstream{ us } {
+// Tracker (in tracker.hpp) wraps another resource and prints every
+// allocation and deallocation, see main() for a chain of them.
+
+// The chain of main() can also be read from a string, e.g. from a config
+// file or the command line, to try other chains without rebuilding.
+void chainFromConfig(const std::string& spec =
+	"sync_pool->tracker(\"  syncpool\")->monotonic(10000)->tracker(\"keeppool:\")") {
+	ResourceChain chain{ spec };
+
+	for (int j = 0; j < 100; ++j) {
+		std::pmr::vector<std::pmr::string> coll{ chain.top() };
+		coll.reserve(100);
+		for (int i = 0; i < 100; ++i) {
+			coll.emplace_back("just a non-SSO string");
+		}
+	}
+	std::cout << "--- leave scope of chain\n";
+}
+
+// monotonic_buffer_resource::release() gives all chunks back, so every
+// request pays the whole growth sequence again. Arena::reset() keeps them:
+// only the first request shows up in the tracker output.
+void resettingArenas() {
+	Tracker track{ "arena:" };
+	Arena arena{ 10000, &track };
+
+	for (int j = 0; j < 5; ++j) {
+		std::cout << "--- request " << j << '\n';
+		{
+			std::pmr::vector<std::pmr::string> coll{ &arena };
+			for (int i = 0; i < 1000; ++i) {
+				coll.emplace_back("just a non-SSO string");
+			}
+		}
+		arena.reset(); // or reset(Arena::Retain::largest) to hold less
+	}
+	std::cout << "--- leave scope of arena\n";
+}
+
+// The growth of an Arena can be tuned: fewer, bigger chunks mean fewer
+// upstream calls, smaller ones less memory held for nothing.
+void tuningArenaGrowth() {
+	Arena::Options opts;
+	opts.initialSize = 10000;
+	opts.growthFactor = 1.5;
+	opts.maxChunkSize = 64 * 1024;
+	opts.roundTo = Arena::pageSize;
+
+	Tracker track{ "arena:" };
+	Arena arena{ opts, &track };
+	std::pmr::vector<std::pmr::string> coll{ &arena };
+	for (int i = 0; i < 10000; ++i) {
+		coll.emplace_back("just a non-SSO string");
+	}
+}
+
+// where betterExampleSyncPool() can only print the options of the
+// standard pool, the in-tree resources tell what they really hold
+void lookingInside() {
+	Pool pool;
+	Arena arena{ 1000 };
+	{
+		std::pmr::map<long, std::pmr::string> coll{ &pool };
+		std::pmr::vector<std::pmr::string> strs{ &arena };
+		for (int i = 0; i < 1000; ++i) {
+			coll.emplace(i, "Customer" + std::to_string(i) + " of the company");
+			strs.emplace_back("just a non-SSO string");
+		}
+		printStats(pool.stats(), "pool: ");
+		printStats(arena.stats(), "arena: ");
 	}
+	// the containers are gone, the pool keeps its chunks:
+	printStats(pool.stats(), "pool: ");
+}
 
-	explicit Tracker(std::string p,
-		             std::pmr::memory_resource* us = std::pmr::get_default_resource())
-		: prefix{ std::move(p) }, upstream{ us } {
+// The loop of main() without the cascade of upstream allocations in its
+// first iterations: a profile taken from one run fills the free lists of
+// the next pool before its first request.
+void prewarmedPool() {
+	auto run = [](std::pmr::memory_resource* res) {
+		std::pmr::vector<std::pmr::string> coll{ res };
+		coll.reserve(100);
+		for (int i = 0; i < 100; ++i) {
+			coll.emplace_back("just a non-SSO string");
+		}
+	};
+	PoolProfile profile;
+	{
+		Pool pool;
+		run(&pool);
+		profile = profileOf(pool.stats());
 	}
 
-private:
-	void* do_allocate(size_t bytes, size_t alignment) override {
-		std::cout << prefix << " allocate " << bytes << " Bytes\n";
-		void* ret = upstream->allocate(bytes, alignment);
-		return ret;
+	Tracker track{ "pool:" };
+	Pool pool{ &track };
+	pool.prewarm(profile);   // or pool.reserve(32, 100) and so on
+	std::cout << "--- prewarmed\n";
+	for (int j = 0; j < 100; ++j) {
+		run(&pool);   // nothing goes upstream anymore
+	}
+	std::cout << "--- leave scope of pool\n";
+}
+
+// TrackNew counts what we ask for, the OS commits a page only when it is
+// first touched. And a pool keeps what it got from upstream until it is
+// released, whether the containers still use it or not.
+void whatTheOsSees() {
+	{
+		OsStats::Scope os;
+		std::array<std::byte, 200000> buf;   // not touched yet
+		std::pmr::monotonic_buffer_resource pool{ buf.data(), buf.size() };
+		std::pmr::vector<std::pmr::string> coll{ &pool };
+		for (int i = 0; i < 1000; ++i) {
+			coll.emplace_back("just a non-SSO string");
+		}
+		std::cout << "filling the stack buffer: ";
+		os.delta().status();
 	}
 
-	void do_deallocate(void* ptr, size_t bytes, size_t alignment) override {
-		std::cout << prefix << " deallocate " << bytes << " Bytes\n";
-		upstream->deallocate(ptr, bytes, alignment);
+	std::size_t before = TrackNew::inUse();
+	std::pmr::synchronized_pool_resource pool;
+	{
+		std::pmr::vector<std::pmr::string> coll{ &pool };
+		for (int i = 0; i < 10000; ++i) {
+			coll.emplace_back("just a non-SSO string");
+		}
 	}
+	std::cout << "pool retains " << TrackNew::inUse() - before
+		<< " bytes, the containers are gone: ";
+	OsStats::now(true).status();
+	pool.release();
+	std::cout << "after release() " << TrackNew::inUse() - before << " bytes: ";
+	OsStats::now(true).status();
+}
 
-	/* Determines if one polymorphic memory resource object can deallocate 
-	   memory allocated by another */
-	bool do_is_equal(const std::pmr::memory_resource& other) const noexcept
-		override {
-		if (this == &other) return true;
-		auto op = dynamic_cast<const Tracker*>(&other);
-		return op != nullptr && op->prefix == prefix
-			&& upstream->is_equal(other);
+// A long-lived pool keeps its historical peak, trim() gives the pages of
+// chunks without a block in use back to the OS but keeps the pool intact
+// (an IdleTrimmer does that once the pool was idle for a while).
+void trimmingIdleMemory() {
+	Pool pool;
+	{
+		std::pmr::vector<std::pmr::string> coll{ &pool };
+		for (int i = 0; i < 100000; ++i) {
+			coll.emplace_back("just a non-SSO string");
+		}
 	}
-};
+	std::cout << "pool after the peak: ";
+	OsStats::now().status();
+	std::cout << pool.trim() << " bytes trimmed: ";
+	OsStats::now().status();
+	printStats(pool.stats(), "pool: ");
+}
 #pragma endregion
 
 
-int main() {
+// without arguments the Tracker chain experiment below, otherwise the
+// scenarios selected on the command line (see runner.hpp), e.g.
+//   Source --scenario map,list --chain "pool->pages" --elements 1000,100000 --json -
+int main(int argc, char* argv[]) {
+	if (argc > 1) {
+		return runFromCommandLine(argc, argv);
+	}
 	{
 		// track allocating chunks of memory (starting with 10k) without deallocating:
 		Tracker track1{ "keeppool:" };
@@ -0,0 +1,607 @@
+#ifndef ADAPTIVEPOOL_HPP
+#define ADAPTIVEPOOL_HPP
+
+#include <memory_resource>
+#include <array>
+#include <vector>
+#include <utility>   // for std::pair
+#include <algorithm> // for std::sort() and std::upper_bound()
+#include <cstddef>   // for std::byte and std::max_align_t
+#include <cstdint>   // for std::uint64_t
+#include "introspect.hpp"
+#include "prewarm.hpp"
+#include "trim.hpp"
+#include "threaddefault.hpp"
+
+// A pool whose size classes follow the workload. It starts like Pool with
+// power-of-two classes, samples about one in sampleEvery requests by their size
+// (in steps of 8 bytes) and every period samples gives the sizes that are
+// hot and waste the most in their power-of-two class an exact-fit class of
+// their own: a 48 byte map node no longer takes a 64 byte block. Sizes
+// that cool down lose their class again. The samples decay by half each
+// period, so a drifting workload is followed without a restart.
+//
+// Which class serves a size only changes while no block of that size is
+// in use, deallocations never have to find out where a block came from.
+// So a size that always has blocks alive (a map that never empties) keeps
+// the class it had when its first block was allocated.
+// Exact classes only serve alignments up to 8, over-aligned requests use
+// the power-of-two classes, requests above largest or aligned above
+// max_align_t go to upstream. Upstream is the type of that resource, as
+// for BasicArena.
+template<typename Upstream>
+class BasicAdaptivePool final : public introspectable_resource
+{
+public:
+	struct Options {
+		std::size_t largest = 4096;       // largest pooled block, rounded up
+		                                  // to a power of two
+		std::size_t maxBlocks = 1024;     // blocks per chunk at most
+		std::size_t sampleEvery = 16;     // a power of two
+		std::size_t period = 512;         // samples between adaptations
+		std::size_t maxExact = 16;        // exact-fit classes at once, at
+		                                  // most one per size (largest / 8)
+		double hotShare = 0.05;           // of the samples for a size to
+		                                  // get a class, cold below half
+		double minWaste = 0.125;          // share of a power-of-two block a
+		                                  // size must waste to get a class
+	};
+
+private:
+	static constexpr std::size_t granule = 8;
+	static constexpr std::size_t maxCoarse = 16;   // 8 bytes .. 256 KiB
+
+	struct Block {
+		Block* next;
+	};
+	// kept at the end of each chunk, behind its blocks
+	struct Chunk {
+		Chunk* next;
+		std::size_t bytes;         // total size including this header
+		std::size_t trimmed = 0;   // bytes given back to the OS by trim()
+	};
+	struct SizeClass {
+		std::size_t blockSize = 0;    // 0: unused exact class
+		Block* free = nullptr;
+		std::byte* cur = nullptr;     // not yet used part of the newest chunk
+		std::byte* end = nullptr;
+		Chunk* chunks = nullptr;
+		Chunk* trimmed = nullptr;     // without blocks, reused first
+		std::size_t nextBlocks = 0;
+		std::size_t blocks = 0;
+		std::size_t inUse = 0;
+		std::size_t requested = 0;
+	};
+	// one for each multiple of 8 up to largest
+	struct Size {
+		std::size_t live = 0;     // blocks of this size in use
+		std::size_t hits = 0;     // samples, halved every period
+		int exact = -1;           // index of its exact class, -1: coarse
+		bool change = false;      // switch classes once live is 0
+	};
+
+	Upstream* upstream;
+	Options opts;
+	std::array<SizeClass, maxCoarse> coarse;
+	std::size_t numCoarse = 0;
+	std::vector<SizeClass> exact;
+	std::vector<Size> sizes;
+	std::size_t countdown = 1;      // requests until the next sample
+	std::uint64_t rng = 0x9e3779b97f4a7c15;
+	std::size_t samples = 0;
+	std::size_t adaptations = 0;
+	std::size_t introduced = 0;
+	std::size_t retired = 0;
+	std::size_t largeBytes = 0;     // passed to upstream as they are
+	std::size_t largeBlocks = 0;
+	std::size_t ops = 0;            // allocations and deallocations
+
+public:
+	explicit BasicAdaptivePool(Upstream* us = get_thread_default())
+		: BasicAdaptivePool{ Options{}, us } {
+	}
+
+	explicit BasicAdaptivePool(const Options& o,
+		Upstream* us = get_thread_default())
+		: upstream{ us }, opts{ o } {
+		// zero means our default, too much the limit
+		if (opts.maxBlocks == 0) {
+			opts.maxBlocks = 1024;
+		}
+		if (opts.largest == 0) {
+			opts.largest = 4096;
+		}
+		if (opts.largest > granule << (maxCoarse - 1)) {
+			opts.largest = granule << (maxCoarse - 1);
+		}
+		if (opts.sampleEvery == 0 || (opts.sampleEvery & (opts.sampleEvery - 1)) != 0) {
+			opts.sampleEvery = 16;
+		}
+		if (opts.period == 0) {
+			opts.period = 512;
+		}
+		for (std::size_t size = granule; ; size *= 2) {
+			init(coarse[numCoarse++], size);
+			if (size >= opts.largest) {
+				break;
+			}
+		}
+		opts.largest = coarse[numCoarse - 1].blockSize;
+		sizes.resize(opts.largest / granule);
+		// more exact classes than sizes would never be used
+		if (opts.maxExact > sizes.size()) {
+			opts.maxExact = sizes.size();
+		}
+		exact.resize(opts.maxExact);
+	}
+
+	BasicAdaptivePool(const BasicAdaptivePool&) = delete;
+	BasicAdaptivePool& operator=(const BasicAdaptivePool&) = delete;
+
+	~BasicAdaptivePool() {
+		release();
+	}
+
+	// hides memory_resource::allocate() for callers that know the type
+	[[nodiscard]]
+	void* allocate(std::size_t bytes,
+		std::size_t alignment = alignof(std::max_align_t)) {
+		++ops;
+		if (alignment > alignof(std::max_align_t) || bytes > opts.largest) {
+			void* p = upstream->allocate(bytes, alignment);
+			largeBytes += bytes;
+			++largeBlocks;
+			return p;
+		}
+		if (alignment > granule) {
+			return take(classFor(bytes, alignment), bytes);
+		}
+		Size& z = sizes[sizeIndex(bytes)];
+		if (--countdown == 0) {
+			countdown = nextGap();
+			++z.hits;
+			if (++samples == opts.period) {
+				adapt();
+			}
+		}
+		void* p = take(classFor(bytes, alignment), bytes);
+		++z.live;
+		return p;
+	}
+
+	void deallocate(void* ptr, std::size_t bytes,
+		std::size_t alignment = alignof(std::max_align_t)) {
+		++ops;
+		if (alignment > alignof(std::max_align_t) || bytes > opts.largest) {
+			upstream->deallocate(ptr, bytes, alignment);
+			largeBytes -= bytes;
+			--largeBlocks;
+			return;
+		}
+		if (alignment > granule) {
+			give(coarseFor(bytes > alignment ? bytes : alignment), ptr, bytes);
+			return;
+		}
+		std::size_t i = sizeIndex(bytes);
+		Size& z = sizes[i];
+		give(z.exact >= 0 ? exact[z.exact] : coarseFor(bytes), ptr, bytes);
+		if (--z.live == 0 && z.change) {
+			switchClass(i);
+		}
+	}
+
+	// makes sure count blocks for size are free in the class serving it
+	// now, taking the missing ones from trimmed chunks first, then from
+	// upstream in one chunk; false for sizes that go to upstream anyway
+	bool reserve(std::size_t size, std::size_t count,
+		std::size_t alignment = alignof(std::max_align_t)) {
+		if (alignment > alignof(std::max_align_t) || size > opts.largest) {
+			return false;
+		}
+		SizeClass& c = classFor(size, alignment);
+		std::size_t available = c.blocks - c.inUse;
+		while (available < count && c.trimmed != nullptr) {
+			available += capacity(c, c.trimmed);
+			reuseTrimmed(c);
+		}
+		if (available < count) {
+			addChunk(c, count - available);
+		}
+		return true;
+	}
+
+	// the blocks of an exact-fit class in a profile of an AdaptivePool were
+	// asked for with alignments up to 8, not with those their size allows
+	void prewarm(const PoolProfile& p) {
+		for (const auto& e : p.entries) {
+			bool exactFit = (e.size & (e.size - 1)) != 0;
+			reserve(e.size, e.count, exactFit && e.alignment > granule ? granule : e.alignment);
+		}
+	}
+
+	// gives the pages of the chunks without a block in use back to the OS
+	// (see trim.hpp) and keeps the chunks for later, returns the bytes
+	std::size_t trim(TrimMode mode = TrimMode::dontNeed) {
+		std::size_t ret = 0;
+		for (std::size_t i = 0; i < numCoarse; ++i) {
+			ret += trimClass(coarse[i], mode);
+		}
+		for (SizeClass& c : exact) {
+			ret += trimClass(c, mode);
+		}
+		return ret;
+	}
+
+	// changes with every allocation and deallocation (see IdleTrimmer)
+	std::size_t activity() const {
+		return ops;
+	}
+
+	// give all chunks back to upstream, blocks larger than the largest
+	// class have to be deallocated by their users
+	void release() noexcept {
+		for (std::size_t i = 0; i < numCoarse; ++i) {
+			freeChunks(coarse[i]);
+		}
+		for (SizeClass& c : exact) {
+			freeChunks(c);
+			c.blockSize = 0;
+		}
+		for (Size& z : sizes) {
+			z = Size{};
+		}
+	}
+
+	Upstream* upstream_resource() const {
+		return upstream;
+	}
+
+	const Options& options() const {
+		return opts;
+	}
+
+	// the sizes that have an exact-fit class now
+	std::vector<std::size_t> exactSizes() const {
+		std::vector<std::size_t> ret;
+		for (const SizeClass& c : exact) {
+			if (c.blockSize != 0) {
+				ret.push_back(c.blockSize);
+			}
+		}
+		std::sort(ret.begin(), ret.end());
+		return ret;
+	}
+
+	// periods evaluated, exact classes created and retired so far
+	std::size_t adaptationCount() const {
+		return adaptations;
+	}
+
+	std::size_t introducedCount() const {
+		return introduced;
+	}
+
+	std::size_t retiredCount() const {
+		return retired;
+	}
+
+	// power-of-two classes first, then the exact ones; blocks larger than
+	// the largest class count as one chunk each, trimmed chunks are still
+	// reserved
+	ResourceStats stats() const override {
+		ResourceStats s;
+		s.bytesInUse = largeBytes;
+		s.bytesReserved = largeBytes;
+		s.chunks = largeBlocks;
+		auto add = [&](const SizeClass& c) {
+			for (Chunk* ch = c.chunks; ch != nullptr; ch = ch->next) {
+				++s.chunks;
+				s.bytesReserved += ch->bytes;
+			}
+			for (Chunk* ch = c.trimmed; ch != nullptr; ch = ch->next) {
+				++s.chunks;
+				s.bytesReserved += ch->bytes;
+				s.bytesTrimmed += ch->trimmed;
+			}
+			s.bytesInUse += c.requested;
+			s.tailWaste += c.inUse * c.blockSize - c.requested;
+			s.sizeClasses.push_back({ c.blockSize, c.blocks, c.inUse });
+		};
+		for (std::size_t i = 0; i < numCoarse; ++i) {
+			add(coarse[i]);
+		}
+		for (const SizeClass& c : exact) {
+			if (c.blockSize != 0) {
+				add(c);
+			}
+		}
+		return s;
+	}
+
+private:
+	// random gaps of 1 .. 2 * sampleEvery requests: a fixed stride would
+	// only ever see one of the sizes of a pattern repeating with it (such
+	// as node, string, node, string, ...)
+	std::size_t nextGap() {
+		rng ^= rng << 13;
+		rng ^= rng >> 7;
+		rng ^= rng << 17;
+		return 1 + static_cast<std::size_t>(rng & (2 * opts.sampleEvery - 1));
+	}
+
+	static std::size_t sizeIndex(std::size_t bytes) {
+		return bytes > 0 ? (bytes - 1) / granule : 0;
+	}
+
+	// the class serving a pooled request now
+	SizeClass& classFor(std::size_t bytes, std::size_t alignment) {
+		if (alignment > granule) {
+			return coarseFor(bytes > alignment ? bytes : alignment);
+		}
+		int e = sizes[sizeIndex(bytes)].exact;
+		return e >= 0 ? exact[e] : coarseFor(bytes);
+	}
+
+	SizeClass& coarseFor(std::size_t size) {
+		std::size_t i = 0;
+		while (coarse[i].blockSize < size) {
+			++i;
+		}
+		return coarse[i];
+	}
+
+	void init(SizeClass& c, std::size_t size) {
+		c = SizeClass{};
+		c.blockSize = size;
+		c.nextBlocks = size < 1024 ? 1024 / size : 1;  // first chunk ~1 KiB
+		if (c.nextBlocks > opts.maxBlocks) {
+			c.nextBlocks = opts.maxBlocks;
+		}
+	}
+
+	void* take(SizeClass& c, std::size_t bytes) {
+		void* p = c.free;
+		if (p != nullptr) {
+			c.free = c.free->next;
+		}
+		else {
+			if (c.cur == c.end) {
+				refill(c);   // may throw, so count the block only after it
+			}
+			p = c.cur;
+			c.cur += c.blockSize;
+		}
+		++c.inUse;
+		c.requested += bytes;
+		return p;
+	}
+
+	void give(SizeClass& c, void* ptr, std::size_t bytes) {
+		--c.inUse;
+		c.requested -= bytes;
+		Block* b = static_cast<Block*>(ptr);
+		b->next = c.free;
+		c.free = b;
+	}
+
+	// chunks are aligned like the blocks in them need, up to max_align_t
+	static std::size_t chunkAlign(const SizeClass& c) {
+		return c.blockSize < alignof(std::max_align_t) ? c.blockSize
+			: alignof(std::max_align_t);
+	}
+
+	void refill(SizeClass& c) {
+		if (c.trimmed != nullptr) {
+			reuseTrimmed(c);
+			return;
+		}
+		std::size_t blocks = c.nextBlocks;
+		addChunk(c, blocks);
+		if (blocks * 2 <= opts.maxBlocks) {
+			c.nextBlocks = blocks * 2;
+		}
+	}
+
+	void addChunk(SizeClass& c, std::size_t blocks) {
+		// a multiple of the alignment, as aligned_alloc() wants it, the header
+		// at the end, so the padding stays less than a block
+		std::size_t bytes = (blocks * c.blockSize + sizeof(Chunk) + chunkAlign(c) - 1)
+			& ~(chunkAlign(c) - 1);
+		std::byte* mem = static_cast<std::byte*>(upstream->allocate(bytes, chunkAlign(c)));
+		c.chunks = ::new (mem + bytes - sizeof(Chunk)) Chunk{ c.chunks, bytes };
+		carve(c, mem, blocks);
+	}
+
+	// the most recently trimmed chunk becomes the newest again, its pages
+	// come back zeroed as they are touched
+	void reuseTrimmed(SizeClass& c) {
+		Chunk* ch = c.trimmed;
+		c.trimmed = ch->next;
+		ch->next = c.chunks;
+		ch->trimmed = 0;
+		c.chunks = ch;
+		carve(c, chunkBegin(ch), capacity(c, ch));
+	}
+
+	// blocks not carved out of the newest chunk yet go to the free list
+	void carve(SizeClass& c, std::byte* mem, std::size_t blocks) {
+		for (; c.cur != c.end; c.cur += c.blockSize) {
+			c.free = ::new (c.cur) Block{ c.free };
+		}
+		c.cur = mem;
+		c.end = mem + blocks * c.blockSize;
+		c.blocks += blocks;
+	}
+
+	static std::byte* chunkBegin(Chunk* ch) {
+		return reinterpret_cast<std::byte*>(ch + 1) - ch->bytes;
+	}
+
+	static std::size_t capacity(const SizeClass& c, const Chunk* ch) {
+		return (ch->bytes - sizeof(Chunk)) / c.blockSize;
+	}
+
+	void freeChunks(SizeClass& c) noexcept {
+		for (Chunk* list : { c.chunks, c.trimmed }) {
+			for (Chunk* ch = list; ch != nullptr; ) {
+				Chunk* next = ch->next;
+				upstream->deallocate(chunkBegin(ch), ch->bytes, chunkAlign(c));
+				ch = next;
+			}
+		}
+		c.free = nullptr;
+		c.cur = c.end = nullptr;
+		c.chunks = c.trimmed = nullptr;
+		c.blocks = c.inUse = c.requested = 0;
+	}
+
+	// moves the chunks of c without a block in use to its trimmed ones
+	std::size_t trimClass(SizeClass& c, TrimMode mode) {
+		if (c.chunks == nullptr || c.inUse == c.blocks) {
+			return 0;
+		}
+		std::vector<Chunk*> chunks;
+		for (Chunk* ch = c.chunks; ch != nullptr; ch = ch->next) {
+			chunks.push_back(ch);
+		}
+		std::sort(chunks.begin(), chunks.end(), [](Chunk* a, Chunk* b) {
+			return chunkBegin(a) < chunkBegin(b);
+		});
+		auto indexOf = [&](const void* p) {
+			auto it = std::upper_bound(chunks.begin(), chunks.end(),
+				static_cast<const std::byte*>(p),
+				[](const std::byte* q, Chunk* ch) { return q < chunkBegin(ch); });
+			return static_cast<std::size_t>(it - chunks.begin()) - 1;
+		};
+		std::vector<std::size_t> free(chunks.size());
+		for (Block* b = c.free; b != nullptr; b = b->next) {
+			++free[indexOf(b)];
+		}
+		if (c.cur != c.end) {
+			free[indexOf(c.cur)] += static_cast<std::size_t>(c.end - c.cur) / c.blockSize;
+		}
+		std::vector<bool> empty(chunks.size());
+		bool any = false;
+		for (std::size_t k = 0; k < chunks.size(); ++k) {
+			empty[k] = free[k] == capacity(c, chunks[k]);
+			any = any || empty[k];
+		}
+		if (!any) {
+			return 0;
+		}
+
+		// none of their blocks may be handed out anymore:
+		for (Block** link = &c.free; *link != nullptr; ) {
+			if (empty[indexOf(*link)]) {
+				*link = (*link)->next;
+			}
+			else {
+				link = &(*link)->next;
+			}
+		}
+		if (c.cur != c.end && empty[indexOf(c.cur)]) {
+			c.cur = c.end = nullptr;
+		}
+		std::size_t ret = 0;
+		for (Chunk** link = &c.chunks; *link != nullptr; ) {
+			Chunk* ch = *link;
+			if (!empty[indexOf(chunkBegin(ch))]) {
+				link = &ch->next;
+				continue;
+			}
+			*link = ch->next;
+			ch->next = c.trimmed;
+			c.trimmed = ch;
+			c.blocks -= capacity(c, ch);
+			ch->trimmed = trimPages(chunkBegin(ch), capacity(c, ch) * c.blockSize, mode);
+			ret += ch->trimmed;
+		}
+		return ret;
+	}
+
+	// decides which sizes should have an exact class from the samples of
+	// the last periods
+	void adapt() {
+		samples = 0;
+		++adaptations;
+		std::size_t total = 0;
+		for (const Size& z : sizes) {
+			total += z.hits;
+		}
+		// hot sizes without a class, those saving the most bytes first
+		std::vector<std::pair<double, std::size_t>> hot;
+		std::size_t kept = 0;
+		for (std::size_t i = 0; i < sizes.size(); ++i) {
+			Size& z = sizes[i];
+			if (z.exact >= 0) {
+				bool cold = z.hits < opts.hotShare / 2 * total;
+				z.change = cold;
+				kept += !cold;
+				continue;
+			}
+			std::size_t size = (i + 1) * granule;
+			std::size_t waste = coarseFor(size).blockSize - size;
+			z.change = false;
+			if (z.hits >= opts.hotShare * total
+				&& waste >= opts.minWaste * coarseFor(size).blockSize) {
+				hot.emplace_back(double(z.hits) * waste, i);
+			}
+		}
+		std::sort(hot.begin(), hot.end(), [](const auto& a, const auto& b) {
+			return a.first > b.first;
+		});
+		for (std::size_t k = 0; k < hot.size() && kept + k < opts.maxExact; ++k) {
+			sizes[hot[k].second].change = true;
+		}
+		for (std::size_t i = 0; i < sizes.size(); ++i) {
+			sizes[i].hits /= 2;
+			if (sizes[i].change && sizes[i].live == 0) {
+				switchClass(i);
+			}
+		}
+	}
+
+	// between the coarse and an exact class, no block of the size in use
+	void switchClass(std::size_t i) {
+		Size& z = sizes[i];
+		z.change = false;
+		if (z.exact >= 0) {
+			freeChunks(exact[z.exact]);
+			exact[z.exact].blockSize = 0;
+			z.exact = -1;
+			++retired;
+			return;
+		}
+		for (std::size_t k = 0; k < exact.size(); ++k) {
+			if (exact[k].blockSize == 0) {
+				// the power-of-two class may have served only this size
+				SizeClass& old = coarseFor((i + 1) * granule);
+				if (old.inUse == 0) {
+					freeChunks(old);
+				}
+				init(exact[k], (i + 1) * granule);
+				z.exact = static_cast<int>(k);
+				++introduced;
+				return;
+			}
+		}
+	}
+
+	void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+		return allocate(bytes, alignment);
+	}
+
+	void do_deallocate(void* ptr, std::size_t bytes, std::size_t alignment)
+		override {
+		deallocate(ptr, bytes, alignment);
+	}
+
+	bool do_is_equal(const std::pmr::memory_resource& other) const noexcept
+		override {
+		return this == &other;
+	}
+};
+
+using AdaptivePool = BasicAdaptivePool<std::pmr::memory_resource>;
+
+#endif // ADAPTIVEPOOL_HPP
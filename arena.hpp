@@ -0,0 +1,368 @@
+#ifndef ARENA_HPP
+#define ARENA_HPP
+
+#include <memory_resource>
+#include <memory>    // for std::align()
+#include <cstddef>   // for std::byte and std::max_align_t
+#include <cstdint>   // for SIZE_MAX
+#include <stdexcept> // for std::invalid_argument
+#include "introspect.hpp"
+#include "trim.hpp"
+#include "threaddefault.hpp"
+
+// A bump allocator like std::pmr::monotonic_buffer_resource, but with
+// checkpoints: mark() remembers the current position and rewind() frees
+// everything allocated after it in O(1). Chunks taken from upstream are
+// kept on rewind and reset() and reused, they only go back upstream on
+// release() or when the arena dies.
+//
+// Upstream is the type chunks come from. Arena takes any memory_resource,
+// with a final in-tree resource as Upstream the calls to it are direct
+// (see compose.hpp).
+template<typename Upstream>
+class BasicArena final : public introspectable_resource
+{
+public:
+	static constexpr std::size_t pageSize = 4096;
+	static constexpr std::size_t hugePageSize = 2 * 1024 * 1024;
+
+	// how chunks taken from upstream grow (monotonic_buffer_resource
+	// doubles them without limit)
+	struct Options {
+		std::size_t initialSize = 1024;  // usable bytes of the first chunk
+		double growthFactor = 2.0;       // next chunk = this chunk * factor,
+		                                 // at least 1
+		std::size_t maxChunkSize = 0;    // stop growing here (rounded up
+		                                 // to roundTo), 0: no limit
+		std::size_t roundTo = 0;         // e.g. pageSize or hugePageSize,
+		                                 // must be a power of two, 0: don't
+		std::size_t reserve = 0;         // bytes to take at construction
+	};
+
+private:
+	// every chunk starts with this header, the usable bytes follow it
+	struct Chunk {
+		Chunk* next;
+		Chunk* prev;
+		std::size_t size;   // total bytes including the header
+		bool owned;         // false for the initial buffer passed in
+		std::size_t used = 0;   // bytes bumped when we moved on to another chunk
+	};
+	static constexpr std::size_t headerSize =
+		(sizeof(Chunk) + alignof(std::max_align_t) - 1)
+		& ~(alignof(std::max_align_t) - 1);
+
+	Upstream* upstream;
+	Options opts;
+	std::size_t chunkAlign;     // alignment of chunks from upstream
+	Chunk* head = nullptr;      // oldest chunk
+	Chunk* tail = nullptr;      // newest chunk
+	Chunk* current = nullptr;   // chunk we are bumping in
+	std::byte* cur = nullptr;   // next free byte in current
+	std::byte* end = nullptr;   // end of current
+	std::size_t nextSize;       // size of the next chunk from upstream
+	std::size_t ops = 0;        // allocations
+
+public:
+	// position in the arena, obtained by mark() and consumed by rewind()
+	class Marker {
+		friend class BasicArena;
+		Chunk* chunk = nullptr;
+		std::byte* pos = nullptr;
+	};
+
+	// marks on construction and rewinds on destruction
+	class Scope {
+	private:
+		BasicArena& arena;
+		Marker marker;
+	public:
+		explicit Scope(BasicArena& a) : arena{ a }, marker{ a.mark() } {
+		}
+		~Scope() {
+			arena.rewind(marker);
+		}
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+	};
+
+	explicit BasicArena(std::size_t initialSize = 1024,
+		Upstream* us = get_thread_default())
+		: BasicArena{ Options{ initialSize }, us } {
+	}
+
+	explicit BasicArena(const Options& o,
+		Upstream* us = get_thread_default())
+		: upstream{ us }, opts{ o },
+		  chunkAlign{ o.roundTo > alignof(std::max_align_t)
+			? o.roundTo : alignof(std::max_align_t) },
+		  nextSize{ o.initialSize + headerSize } {
+		// chunks must not shrink, a NaN fails this as well
+		if (!(opts.growthFactor >= 1)) {
+			throw std::invalid_argument{ "arena growth factor below 1" };
+		}
+		if (opts.reserve > 0) {
+			enter(grow(opts.reserve));
+		}
+	}
+
+	// use the passed buffer (e.g. on the stack) before going upstream
+	BasicArena(void* buffer, std::size_t size,
+		Upstream* us = get_thread_default())
+		: BasicArena{ buffer, size, Options{ size * 2 }, us } {
+	}
+
+	BasicArena(void* buffer, std::size_t size, const Options& o,
+		Upstream* us = get_thread_default())
+		: BasicArena{ Options{ o.initialSize, o.growthFactor, o.maxChunkSize,
+			o.roundTo }, us } {
+		void* p = buffer;
+		std::size_t space = size;
+		if (std::align(alignof(Chunk), headerSize, p, space)) {
+			Chunk* c = ::new (p) Chunk{ nullptr, nullptr, space, false };
+			head = tail = c;
+			enter(c);
+		}
+		if (o.reserve > 0) {
+			grow(o.reserve);
+		}
+	}
+
+	BasicArena(const BasicArena&) = delete;
+	BasicArena& operator=(const BasicArena&) = delete;
+
+	~BasicArena() {
+		release();
+	}
+
+	// hides memory_resource::allocate() for callers that know the type
+	// (see static_allocator), so the bump can be inlined
+	[[nodiscard]]
+	void* allocate(std::size_t bytes,
+		std::size_t alignment = alignof(std::max_align_t)) {
+		++ops;
+		if (void* p = bump(bytes, alignment)) {
+			return p;
+		}
+		return allocateSlow(bytes, alignment);
+	}
+
+	// like monotonic_buffer_resource, single deallocations are no-ops
+	void deallocate(void*, std::size_t,
+		std::size_t = alignof(std::max_align_t)) noexcept {
+	}
+
+	Marker mark() const {
+		Marker m;
+		m.chunk = current;
+		m.pos = cur;
+		return m;
+	}
+
+	// free everything allocated since m was taken. Markers taken after m
+	// become invalid.
+	void rewind(Marker m) noexcept {
+		current = m.chunk;
+		cur = m.pos;
+		end = current ? reinterpret_cast<std::byte*>(current) + current->size
+			: nullptr;
+	}
+
+	// what reset() keeps of the chunks taken from upstream
+	enum class Retain { all, largest };
+
+	// free everything but keep chunks for the next round, so a warmed up
+	// arena does no upstream allocations at all. With Retain::largest only
+	// the biggest chunk survives, which caps what an idle arena holds.
+	void reset(Retain what = Retain::all) noexcept {
+		if (what == Retain::largest) {
+			Chunk* largest = nullptr;
+			for (Chunk* c = head; c != nullptr; c = c->next) {
+				if (c->owned && (largest == nullptr || c->size > largest->size)) {
+					largest = c;
+				}
+			}
+			Chunk* keep = nullptr;   // the initial buffer, if any
+			for (Chunk* c = head; c != nullptr; ) {
+				Chunk* next = c->next;
+				if (!c->owned) {
+					keep = c;
+				}
+				else if (c != largest) {
+					upstream->deallocate(c, c->size, chunkAlign);
+				}
+				c = next;
+			}
+			head = keep ? keep : largest;
+			tail = largest ? largest : keep;
+			if (keep != nullptr) {
+				keep->prev = nullptr;
+				keep->next = largest;
+			}
+			if (largest != nullptr) {
+				largest->prev = keep;
+				largest->next = nullptr;
+			}
+		}
+		current = nullptr;
+		cur = end = nullptr;
+		if (head != nullptr) {
+			enter(head);
+		}
+	}
+
+	// gives the pages of what is free, the rest of the current chunk and
+	// the chunks after it, back to the OS (see trim.hpp) and keeps the
+	// chunks. The initial buffer is left alone. Returns the bytes.
+	std::size_t trim(TrimMode mode = TrimMode::dontNeed) noexcept {
+		std::size_t ret = 0;
+		if (current != nullptr && current->owned) {
+			ret += trimPages(cur, static_cast<std::size_t>(end - cur), mode);
+		}
+		for (Chunk* c = current ? current->next : head; c != nullptr; c = c->next) {
+			if (c->owned) {
+				ret += trimPages(data(c), c->size - headerSize, mode);
+			}
+		}
+		return ret;
+	}
+
+	// changes with every allocation (see IdleTrimmer)
+	std::size_t activity() const {
+		return ops;
+	}
+
+	// give all chunks back to upstream (the initial buffer is kept)
+	void release() noexcept {
+		Chunk* keep = nullptr;
+		for (Chunk* c = head; c != nullptr; ) {
+			Chunk* next = c->next;
+			if (c->owned) {
+				upstream->deallocate(c, c->size, chunkAlign);
+			}
+			else {
+				keep = c;
+			}
+			c = next;
+		}
+		head = tail = keep;
+		current = nullptr;
+		cur = end = nullptr;
+		if (keep != nullptr) {
+			keep->next = keep->prev = nullptr;
+			enter(keep);
+		}
+	}
+
+	Upstream* upstream_resource() const {
+		return upstream;
+	}
+
+	const Options& options() const {
+		return opts;
+	}
+
+	// the chunks before the current one are in use up to where we left
+	// them, their rest is tail waste. Chunks after it are free (kept from
+	// before a rewind or reset).
+	ResourceStats stats() const override {
+		ResourceStats s;
+		bool before = current != nullptr;
+		for (Chunk* c = head; c != nullptr; c = c->next) {
+			++s.chunks;
+			s.bytesReserved += c->size;
+			if (c == current) {
+				s.bytesInUse += static_cast<std::size_t>(cur - data(c));
+				before = false;
+			}
+			else if (before) {
+				s.bytesInUse += c->used;
+				s.tailWaste += c->size - headerSize - c->used;
+			}
+		}
+		return s;
+	}
+
+private:
+	static std::byte* data(Chunk* c) noexcept {
+		return reinterpret_cast<std::byte*>(c) + headerSize;
+	}
+
+	// leave the current chunk (remembering how far it is used) for c
+	void enter(Chunk* c) noexcept {
+		if (current != nullptr) {
+			current->used = static_cast<std::size_t>(cur - data(current));
+		}
+		current = c;
+		cur = data(c);
+		end = reinterpret_cast<std::byte*>(c) + c->size;
+	}
+
+	void* bump(std::size_t bytes, std::size_t alignment) noexcept {
+		void* p = cur;
+		std::size_t space = static_cast<std::size_t>(end - cur);
+		if (cur == nullptr || !std::align(alignment, bytes, p, space)) {
+			return nullptr;
+		}
+		cur = static_cast<std::byte*>(p) + bytes;
+		return p;
+	}
+
+	void* allocateSlow(std::size_t bytes, std::size_t alignment) {
+		// try the chunks we kept from before a rewind:
+		for (Chunk* c = current ? current->next : head; c != nullptr; c = c->next) {
+			enter(c);
+			if (void* p = bump(bytes, alignment)) {
+				return p;
+			}
+		}
+		// and only then ask upstream for a new one:
+		enter(grow(bytes + alignment));
+		return bump(bytes, alignment);
+	}
+
+	// append a chunk with at least the passed usable bytes
+	Chunk* grow(std::size_t usable) {
+		std::size_t size = nextSize;
+		if (size < usable + headerSize) {
+			size = usable + headerSize;   // may exceed maxChunkSize
+		}
+		size = (size + chunkAlign - 1) & ~(chunkAlign - 1);
+
+		void* mem = upstream->allocate(size, chunkAlign);
+		Chunk* c = ::new (mem) Chunk{ nullptr, tail, size, true };
+		if (tail != nullptr) {
+			tail->next = c;
+		}
+		else {
+			head = c;
+		}
+		tail = c;
+
+		double next = static_cast<double>(size) * opts.growthFactor;
+		nextSize = next > static_cast<double>(SIZE_MAX / 2)
+			? SIZE_MAX / 2 : static_cast<std::size_t>(next);
+		if (opts.maxChunkSize > 0 && nextSize > opts.maxChunkSize) {
+			nextSize = opts.maxChunkSize;
+		}
+		return c;
+	}
+
+	void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+		return allocate(bytes, alignment);
+	}
+
+	void do_deallocate(void* p, std::size_t bytes, std::size_t alignment)
+		override {
+		deallocate(p, bytes, alignment);
+	}
+
+	bool do_is_equal(const std::pmr::memory_resource& other) const noexcept
+		override {
+		return this == &other;
+	}
+};
+
+using Arena = BasicArena<std::pmr::memory_resource>;
+
+#endif // ARENA_HPP
@@ -0,0 +1,145 @@
+// Runs a workload that drifts through phases, each with other hot sizes,
+// on Pool and AdaptivePool, and reports per phase the mean time per
+// element with its 95% confidence interval, the bytes reserved and lost
+// to rounding up blocks while the containers are full, and which
+// exact-fit classes AdaptivePool has by its end.
+//
+//   map     std::pmr::map<long, std::pmr::string>, strings of 40 chars
+//   list    std::pmr::list of a 24 byte struct
+//   strings std::pmr::vector<std::pmr::string> of 90 char strings
+//
+// build: g++ -std=c++17 -O2 bench/adaptive.cpp -o adaptive
+// usage: adaptive [--elements 2000] [--reps 50] [--warmup 3] [--json file]
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <list>
+#include <type_traits>
+#include <memory_resource>
+#include "../benchmark.hpp"
+#include "../pool.hpp"
+#include "../adaptivepool.hpp"
+
+volatile std::size_t sink;   // keeps the work from being optimized away
+
+struct Item {
+	long a, b, c;
+};
+
+struct Phase {
+	const char* name;
+	// fills containers on res, calls full() before they die
+	void (*run)(std::pmr::memory_resource* res, int num, void (*full)(void*), void* ctx);
+};
+
+const Phase phases[] = {
+	{ "map", [](std::pmr::memory_resource* res, int num, void (*full)(void*), void* ctx) {
+		std::pmr::map<long, std::pmr::string> coll{ res };
+		for (int i = 0; i < num; ++i) {
+			coll.emplace(i, std::string(40, 'x'));
+		}
+		full(ctx);
+		sink = coll.size();
+	} },
+	{ "list", [](std::pmr::memory_resource* res, int num, void (*full)(void*), void* ctx) {
+		std::pmr::list<Item> coll{ res };
+		for (int i = 0; i < num; ++i) {
+			coll.push_back(Item{ i, i, i });
+		}
+		full(ctx);
+		sink = coll.size();
+	} },
+	{ "strings", [](std::pmr::memory_resource* res, int num, void (*full)(void*), void* ctx) {
+		std::pmr::vector<std::pmr::string> coll{ res };
+		coll.reserve(num);
+		for (int i = 0; i < num; ++i) {
+			coll.emplace_back(90, 'x');
+		}
+		full(ctx);
+		sink = coll.size();
+	} },
+};
+
+struct Full {
+	const introspectable_resource* res;
+	ResourceStats stats;
+};
+
+// one pool through all phases, so AdaptivePool has to follow the drift
+template<typename P>
+void runPhases(const char* name, int num, const BenchConfig& cfg,
+	std::vector<BenchResult>& results) {
+	P pool;
+	Full f{ &pool, {} };
+	for (const Phase& phase : phases) {
+		BenchResult r = runBenchmark(name, { { "phase", phase.name },
+			{ "elements", std::to_string(num) } }, num, cfg, [&] {
+				phase.run(&pool, num, [](void* ctx) {
+					Full& f = *static_cast<Full*>(ctx);
+					f.stats = f.res->stats();
+				}, &f);
+			});
+		r.metrics.emplace_back("reserved", double(f.stats.bytesReserved));
+		r.metrics.emplace_back("tail_waste", double(f.stats.tailWaste));
+		Summary s = r.summary();
+		std::cout << std::setw(14) << name << std::setw(9) << phase.name
+			<< std::fixed << std::setprecision(1) << std::setw(9) << s.mean / num
+			<< std::setw(9) << (s.ciHigh - s.mean) / num
+			<< std::setw(12) << f.stats.bytesReserved
+			<< std::setw(12) << f.stats.tailWaste << "  ";
+		if constexpr (std::is_same_v<P, AdaptivePool>) {
+			r.metrics.emplace_back("exact_classes", double(pool.exactSizes().size()));
+			for (std::size_t size : pool.exactSizes()) {
+				std::cout << size << ' ';
+			}
+		}
+		std::cout << '\n';
+		results.push_back(std::move(r));
+	}
+}
+
+int main(int argc, char* argv[]) {
+	int num = 2000;
+	BenchConfig cfg{ 3, 50 };
+	std::string jsonFile;
+	try {
+		BenchArgs args{ argc, argv };
+		while (args.next()) {
+			if (args.is("--elements")) {
+				num = args.number(1, 100000000);
+			}
+			else if (args.is("--reps")) {
+				cfg.repetitions = args.number(1, 1000000);
+			}
+			else if (args.is("--warmup")) {
+				cfg.warmup = args.number(0, 1000000);
+			}
+			else if (args.is("--json")) {
+				jsonFile = args.value();
+			}
+			else {
+				args.unknown();
+			}
+		}
+	}
+	catch (const std::invalid_argument& e) {
+		std::cerr << e.what() << '\n';
+		return 1;
+	}
+
+	std::cout << std::setw(14) << "resource" << std::setw(9) << "phase"
+		<< std::setw(9) << "ns/elem" << std::setw(9) << "+-95%" << std::setw(12) << "reserved"
+		<< std::setw(12) << "tail waste" << "  exact classes\n";
+	std::vector<BenchResult> results;
+	runPhases<Pool>("Pool", num, cfg, results);
+	runPhases<AdaptivePool>("AdaptivePool", num, cfg, results);
+
+	if (!jsonFile.empty()) {
+		std::ofstream out{ jsonFile };
+		writeJson(out, "adaptive", results);
+	}
+}
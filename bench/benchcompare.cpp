@@ -0,0 +1,355 @@
+// Compares two JSON result files of the benchmarks (see writeJson() in
+// benchmark.hpp), result by result, matched on name and params: median
+// time with a two-sided Mann-Whitney U test of the samples, allocations
+// and peak bytes per run. A result regresses when it got slower by more
+// than the time threshold with p below alpha, or made more allocations or
+// used more peak bytes than their thresholds allow. The exit code is 1 if
+// anything regressed, so a build can be gated on it.
+//
+// build: g++ -std=c++17 -O2 bench/benchcompare.cpp -o benchcompare
+// usage: benchcompare base.json new.json [--time 5] [--allocs 0] [--peak 10]
+//                     [--alpha 0.05]     (thresholds in percent)
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <map>
+#include <memory>
+#include <algorithm>
+#include <stdexcept>
+#include <cmath>
+#include <cstdlib>
+#include <cctype>
+#include "../benchmark.hpp"   // for BenchArgs
+
+// just enough JSON for what writeJson() writes
+struct Json {
+	enum class Type { null, boolean, number, string, array, object } type = Type::null;
+	double number = 0;
+	std::string string;
+	std::vector<Json> array;
+	std::vector<std::pair<std::string, Json>> object;
+
+	const Json* find(const std::string& key) const {
+		for (const auto& [k, v] : object) {
+			if (k == key) {
+				return &v;
+			}
+		}
+		return nullptr;
+	}
+	double numberAt(const std::string& key) const {
+		const Json* v = find(key);
+		return v && v->type == Type::number ? v->number : 0;
+	}
+};
+
+class JsonParser
+{
+private:
+	const std::string& s;
+	std::size_t i = 0;
+
+public:
+	explicit JsonParser(const std::string& text) : s{ text } {
+	}
+
+	Json parse() {
+		Json v = value();
+		skipSpace();
+		if (i != s.size()) {
+			fail("trailing characters");
+		}
+		return v;
+	}
+
+private:
+	[[noreturn]] void fail(const std::string& what) const {
+		throw std::runtime_error{ "JSON: " + what + " at " + std::to_string(i) };
+	}
+
+	void skipSpace() {
+		while (i < s.size() && std::isspace(static_cast<unsigned char>(s[i]))) {
+			++i;
+		}
+	}
+
+	void expect(char c) {
+		skipSpace();
+		if (i >= s.size() || s[i] != c) {
+			fail(std::string{ "'" } + c + "' expected");
+		}
+		++i;
+	}
+
+	std::string str() {
+		expect('"');
+		std::string ret;
+		while (i < s.size() && s[i] != '"') {
+			char c = s[i++];
+			if (c == '\\' && i < s.size()) {
+				c = s[i++];
+				switch (c) {
+				case 'n': c = '\n'; break;
+				case 't': c = '\t'; break;
+				default: break;        // \" \\ \/ as is
+				}
+			}
+			ret += c;
+		}
+		expect('"');
+		return ret;
+	}
+
+	Json value() {
+		skipSpace();
+		if (i >= s.size()) {
+			fail("value expected");
+		}
+		Json v;
+		char c = s[i];
+		if (c == '{') {
+			v.type = Json::Type::object;
+			++i;
+			skipSpace();
+			if (i < s.size() && s[i] == '}') {
+				++i;
+				return v;
+			}
+			do {
+				std::string key = str();
+				expect(':');
+				v.object.emplace_back(std::move(key), value());
+				skipSpace();
+			} while (i < s.size() && s[i] == ',' && ++i);
+			expect('}');
+		}
+		else if (c == '[') {
+			v.type = Json::Type::array;
+			++i;
+			skipSpace();
+			if (i < s.size() && s[i] == ']') {
+				++i;
+				return v;
+			}
+			do {
+				v.array.push_back(value());
+				skipSpace();
+			} while (i < s.size() && s[i] == ',' && ++i);
+			expect(']');
+		}
+		else if (c == '"') {
+			v.type = Json::Type::string;
+			v.string = str();
+		}
+		else if (s.compare(i, 4, "true") == 0 || s.compare(i, 5, "false") == 0) {
+			v.type = Json::Type::boolean;
+			v.number = s[i] == 't';
+			i += s[i] == 't' ? 4 : 5;
+		}
+		else if (s.compare(i, 4, "null") == 0) {
+			i += 4;
+		}
+		else {
+			char* end = nullptr;
+			v.type = Json::Type::number;
+			v.number = std::strtod(s.c_str() + i, &end);
+			if (end == s.c_str() + i) {
+				fail("value expected");
+			}
+			i = end - s.c_str();
+		}
+		return v;
+	}
+};
+
+struct Result {
+	std::vector<double> samples;
+	double median = 0;
+	double allocs = 0;
+	double peak = 0;
+};
+
+// results by "name params"
+std::map<std::string, Result> load(const char* file) {
+	std::ifstream in{ file };
+	if (!in) {
+		throw std::runtime_error{ std::string{ "can't open " } + file };
+	}
+	std::stringstream buf;
+	buf << in.rdbuf();
+	std::string text = buf.str();
+	Json root = JsonParser{ text }.parse();
+	const Json* results = root.find("results");
+	if (!results || results->type != Json::Type::array) {
+		throw std::runtime_error{ std::string{ "no results in " } + file };
+	}
+
+	std::map<std::string, Result> ret;
+	for (const Json& r : results->array) {
+		const Json* name = r.find("name");
+		std::string key = name ? name->string : "?";
+		if (const Json* params = r.find("params")) {
+			for (const auto& [k, v] : params->object) {
+				key += " " + k + "=" + v.string;
+			}
+		}
+		Result res;
+		if (const Json* samples = r.find("samples_ns")) {
+			for (const Json& x : samples->array) {
+				res.samples.push_back(x.number);
+			}
+		}
+		res.median = r.numberAt("median_ns");
+		res.allocs = r.numberAt("allocs_per_run");
+		res.peak = r.numberAt("peak_bytes");
+		ret[key] = std::move(res);
+	}
+	return ret;
+}
+
+// two-sided p-value of the Mann-Whitney U test, normal approximation
+// with tie correction (fine from about 8 samples per side)
+double mannWhitney(const std::vector<double>& a, const std::vector<double>& b) {
+	std::size_t n1 = a.size(), n2 = b.size();
+	if (n1 == 0 || n2 == 0) {
+		return 1;
+	}
+	std::vector<std::pair<double, int>> all;
+	for (double x : a) {
+		all.emplace_back(x, 0);
+	}
+	for (double x : b) {
+		all.emplace_back(x, 1);
+	}
+	std::sort(all.begin(), all.end());
+
+	double rankSumA = 0, ties = 0;
+	for (std::size_t i = 0; i < all.size(); ) {
+		std::size_t j = i;
+		while (j < all.size() && all[j].first == all[i].first) {
+			++j;
+		}
+		double rank = (i + 1 + j) / 2.0;   // average of ranks i+1 .. j
+		for (std::size_t k = i; k < j; ++k) {
+			if (all[k].second == 0) {
+				rankSumA += rank;
+			}
+		}
+		double t = double(j - i);
+		ties += t * t * t - t;
+		i = j;
+	}
+	double n = double(n1 + n2);
+	double u = rankSumA - n1 * (n1 + 1) / 2.0;
+	double mean = n1 * n2 / 2.0;
+	double var = n1 * n2 / 12.0 * ((n + 1) - ties / (n * (n - 1)));
+	if (var <= 0) {
+		return 1;
+	}
+	double z = (std::abs(u - mean) - 0.5) / std::sqrt(var);   // continuity correction
+	return z <= 0 ? 1 : std::erfc(z / std::sqrt(2.0));
+}
+
+double change(double base, double now) {
+	return base != 0 ? 100 * (now - base) / base : (now != 0 ? 100 : 0);
+}
+
+int main(int argc, char* argv[]) {
+	std::vector<std::string> files;
+	double timeLimit = 5, allocLimit = 0, peakLimit = 10, alpha = 0.05;
+	try {
+		BenchArgs args{ argc, argv };
+		while (args.next()) {
+			if (!args.isOption()) {
+				files.push_back(args.arg());
+			}
+			else if (args.is("--time")) {
+				timeLimit = args.number(0.0);
+			}
+			else if (args.is("--allocs")) {
+				allocLimit = args.number(0.0);
+			}
+			else if (args.is("--peak")) {
+				peakLimit = args.number(0.0);
+			}
+			else if (args.is("--alpha")) {
+				alpha = args.number(0.0, 1.0);
+			}
+			else {
+				args.unknown();
+			}
+		}
+	}
+	catch (const std::invalid_argument& e) {
+		std::cerr << e.what() << '\n';
+		return 2;
+	}
+	if (files.size() != 2) {
+		std::cerr << "usage: benchcompare base.json new.json [--time %] [--allocs %]"
+			" [--peak %] [--alpha p]\n";
+		return 2;
+	}
+
+	std::map<std::string, Result> base, now;
+	try {
+		base = load(files[0].c_str());
+		now = load(files[1].c_str());
+	}
+	catch (const std::exception& e) {
+		std::cerr << e.what() << '\n';
+		return 2;
+	}
+
+	std::cout << std::left << std::setw(48) << "benchmark" << std::right
+		<< std::setw(12) << "base ns" << std::setw(12) << "new ns" << std::setw(9) << "time"
+		<< std::setw(8) << "p" << std::setw(9) << "allocs" << std::setw(9) << "peak"
+		<< "  verdict\n";
+	int regressions = 0;
+	for (const auto& [key, b] : base) {
+		auto it = now.find(key);
+		if (it == now.end()) {
+			std::cout << std::left << std::setw(48) << key << "  missing in " << files[1] << '\n';
+			continue;
+		}
+		const Result& n = it->second;
+		double dt = change(b.median, n.median);
+		double p = mannWhitney(b.samples, n.samples);
+		double da = change(b.allocs, n.allocs);
+		double dp = change(b.peak, n.peak);
+
+		std::string verdict;
+		if (dt > timeLimit && p < alpha) {
+			verdict += " slower";
+		}
+		if (da > allocLimit) {
+			verdict += " allocs";
+		}
+		if (dp > peakLimit) {
+			verdict += " peak";
+		}
+		if (verdict.empty()) {
+			verdict = dt < -timeLimit && p < alpha ? " faster" : " ok";
+		}
+		else {
+			verdict = " REGRESSION:" + verdict;
+			++regressions;
+		}
+		std::cout << std::left << std::setw(48) << key << std::right << std::fixed
+			<< std::setprecision(0) << std::setw(12) << b.median << std::setw(12) << n.median
+			<< std::showpos << std::setprecision(1) << std::setw(8) << dt << '%'
+			<< std::noshowpos << std::setprecision(3) << std::setw(8) << p
+			<< std::showpos << std::setprecision(1) << std::setw(8) << da << '%'
+			<< std::setw(8) << dp << '%' << std::noshowpos << ' ' << verdict << '\n';
+	}
+	for (const auto& [key, n] : now) {
+		if (base.count(key) == 0) {
+			std::cout << std::left << std::setw(48) << key << "  new in " << files[1] << '\n';
+		}
+	}
+	std::cout << regressions << " regression" << (regressions == 1 ? "" : "s") << '\n';
+	return regressions ? 1 : 0;
+}
@@ -0,0 +1,299 @@
+// Hammers resources from 1..N threads with a random mix of allocations and
+// deallocations and reports throughput, scaling efficiency (throughput
+// with n threads / (n * throughput with one)) and p50/p99 latency. Shared
+// resources are used by all threads at once, per-thread ones (the
+// unsynchronized pools and arenas) once per thread.
+//
+// This quantifies the warning above exampleSyncPoolBadImpl() in
+// Source.cpp: "pool+mutex" is a Pool shared behind a LockedResource.
+//
+// build: g++ -std=c++17 -O2 -pthread bench/contention.cpp -o contention
+// usage: contention [--threads 1,2,4,8] [--sizes small|strings|mixed|large|8,24,...]
+//                   [--alloc-ratio 0.5] [--ops 200000] [--reps 5]
+//                   [--only name] [--json file]
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <atomic>
+#include <random>
+#include <chrono>
+#include <cstdlib>
+#include <cctype>    // for std::isdigit()
+#include <memory_resource>
+#include "../benchmark.hpp"
+#include "../pool.hpp"
+#include "../arena.hpp"
+#include "../lockedresource.hpp"
+
+// owns what it created, res is what the threads use
+struct Instance {
+	std::vector<std::unique_ptr<std::pmr::memory_resource>> owned;
+	std::pmr::memory_resource* res = nullptr;
+};
+
+struct ResourceKind {
+	const char* name;
+	bool shared;                      // one for all threads or one per thread
+	std::function<Instance()> make;
+};
+
+template<typename R, typename... Args>
+Instance makeOwned(Args... args) {
+	Instance i;
+	i.owned.push_back(std::make_unique<R>(args...));
+	i.res = i.owned.back().get();
+	return i;
+}
+
+const std::vector<ResourceKind>& resourceKinds() {
+	static const std::vector<ResourceKind> kinds{
+		{ "new_delete", true, [] {
+			Instance i;
+			i.res = std::pmr::new_delete_resource();
+			return i; } },
+		{ "synchronized_pool", true, [] {
+			return makeOwned<std::pmr::synchronized_pool_resource>(); } },
+		{ "pool+mutex", true, [] {
+			Instance i = makeOwned<Pool>();
+			i.owned.push_back(std::make_unique<LockedResource>(i.res));
+			i.res = i.owned.back().get();
+			return i; } },
+		{ "unsynchronized_pool", false, [] {
+			return makeOwned<std::pmr::unsynchronized_pool_resource>(); } },
+		{ "Pool", false, [] {
+			return makeOwned<Pool>(); } },
+		{ "Arena", false, [] {
+			return makeOwned<Arena>(std::size_t{ 64 * 1024 }); } },
+	};
+	return kinds;
+}
+
+std::vector<std::size_t> sizeMix(const std::string& spec) {
+	if (spec == "small") {
+		return { 8, 16, 24, 32, 48, 64 };
+	}
+	if (spec == "strings") {           // pmr::string buffers of short texts
+		return { 22, 32, 48, 64, 100 };
+	}
+	if (spec == "mixed") {
+		return { 8, 16, 32, 64, 128, 256, 512, 1024, 4096 };
+	}
+	if (spec == "large") {
+		return { 1024, 4096, 16384, 65536 };
+	}
+	std::vector<std::size_t> sizes;
+	std::istringstream is{ spec };
+	for (std::string n; std::getline(is, n, ','); ) {
+		char* end = nullptr;
+		unsigned long size = std::strtoul(n.c_str(), &end, 10);
+		if (n.empty() || !std::isdigit(static_cast<unsigned char>(n[0]))
+			|| *end != '\0' || size == 0 || size > (1ul << 30)) {
+			return {};   // not a list of sizes
+		}
+		sizes.push_back(size);
+	}
+	return sizes;
+}
+
+// the random decisions of one thread, made before timing
+struct Plan {
+	std::vector<std::size_t> size;
+	std::vector<std::uint32_t> pick;
+	std::vector<bool> alloc;
+};
+
+Plan makePlan(std::size_t ops, const std::vector<std::size_t>& sizes,
+	double allocRatio, unsigned seed) {
+	std::mt19937 rng{ seed };
+	std::uniform_int_distribution<std::size_t> sz{ 0, sizes.size() - 1 };
+	std::bernoulli_distribution al{ allocRatio };
+	Plan p;
+	p.size.reserve(ops);
+	p.pick.reserve(ops);
+	p.alloc.reserve(ops);
+	for (std::size_t i = 0; i < ops; ++i) {
+		p.size.push_back(sizes[sz(rng)]);
+		p.pick.push_back(rng());
+		p.alloc.push_back(al(rng));
+	}
+	return p;
+}
+
+constexpr std::size_t maxLive = 4096;        // blocks a thread holds at most
+constexpr std::size_t latencyEvery = 16;     // time every 16th operation
+
+void worker(std::pmr::memory_resource* res, const Plan& plan,
+	std::atomic<bool>& go, std::vector<double>& latencies) {
+	std::vector<std::pair<void*, std::size_t>> live;
+	live.reserve(maxLive);
+	while (!go.load(std::memory_order_acquire)) {
+		std::this_thread::yield();
+	}
+
+	for (std::size_t i = 0; i < plan.size.size(); ++i) {
+		bool timed = i % latencyEvery == 0;
+		auto start = timed ? std::chrono::steady_clock::now()
+			: std::chrono::steady_clock::time_point{};
+		if (live.empty() || (live.size() < maxLive && plan.alloc[i])) {
+			std::size_t size = plan.size[i];
+			void* p = res->allocate(size, alignof(std::max_align_t));
+			*static_cast<char*>(p) = 1;   // touch it like a real user would
+			live.emplace_back(p, size);
+		}
+		else {
+			std::size_t idx = plan.pick[i] % live.size();
+			std::swap(live[idx], live.back());
+			res->deallocate(live.back().first, live.back().second,
+				alignof(std::max_align_t));
+			live.pop_back();
+		}
+		if (timed) {
+			auto stop = std::chrono::steady_clock::now();
+			latencies.push_back(std::chrono::duration<double, std::nano>(stop - start).count());
+		}
+	}
+	for (auto& [p, size] : live) {
+		res->deallocate(p, size, alignof(std::max_align_t));
+	}
+}
+
+// wall time of one run of all threads in ns
+double runOnce(const ResourceKind& kind, const std::vector<Plan>& plans,
+	std::vector<double>& latencies) {
+	std::size_t n = plans.size();
+	std::vector<Instance> instances;
+	instances.push_back(kind.make());
+	for (std::size_t t = 1; !kind.shared && t < n; ++t) {
+		instances.push_back(kind.make());
+	}
+
+	std::atomic<bool> go{ false };
+	std::vector<std::vector<double>> lat(n);
+	std::vector<std::thread> threads;
+	for (std::size_t t = 0; t < n; ++t) {
+		lat[t].reserve(plans[t].size.size() / latencyEvery + 1);
+		std::pmr::memory_resource* res = instances[kind.shared ? 0 : t].res;
+		threads.emplace_back(worker, res, std::cref(plans[t]), std::ref(go), std::ref(lat[t]));
+	}
+	auto start = std::chrono::steady_clock::now();
+	go.store(true, std::memory_order_release);
+	for (auto& th : threads) {
+		th.join();
+	}
+	auto stop = std::chrono::steady_clock::now();
+
+	for (auto& l : lat) {
+		latencies.insert(latencies.end(), l.begin(), l.end());
+	}
+	return std::chrono::duration<double, std::nano>(stop - start).count();
+}
+
+int main(int argc, char* argv[]) {
+	std::vector<int> threadCounts;
+	for (unsigned n = 1; n < std::thread::hardware_concurrency(); n *= 2) {
+		threadCounts.push_back(static_cast<int>(n));
+	}
+	threadCounts.push_back(static_cast<int>(std::thread::hardware_concurrency()
+		? std::thread::hardware_concurrency() : 1));
+	std::string sizes = "small", only, jsonFile;
+	double allocRatio = 0.5;
+	std::size_t ops = 200000;
+	int reps = 5;
+
+	try {
+		BenchArgs args{ argc, argv };
+		while (args.next()) {
+			if (args.is("--threads")) {
+				threadCounts = args.numbers(1, 1024);
+			}
+			else if (args.is("--sizes")) {
+				sizes = args.value();
+			}
+			else if (args.is("--alloc-ratio")) {
+				allocRatio = args.number(0.0, 1.0);
+			}
+			else if (args.is("--ops")) {
+				ops = args.number<std::size_t>(1);
+			}
+			else if (args.is("--reps")) {
+				reps = args.number(1, 1000000);
+			}
+			else if (args.is("--only")) {
+				only = args.value();
+			}
+			else if (args.is("--json")) {
+				jsonFile = args.value();
+			}
+			else {
+				args.unknown();
+			}
+		}
+	}
+	catch (const std::invalid_argument& e) {
+		std::cerr << e.what() << '\n';
+		return 1;
+	}
+	std::vector<std::size_t> mix = sizeMix(sizes);
+	if (mix.empty()) {
+		std::cerr << "unknown sizes " << sizes << '\n';
+		return 1;
+	}
+
+	std::cout << std::left << std::setw(22) << "resource" << std::right
+		<< std::setw(8) << "threads" << std::setw(12) << "Mops/s"
+		<< std::setw(12) << "scaling" << std::setw(10) << "p50 ns"
+		<< std::setw(10) << "p99 ns" << '\n';
+
+	std::vector<BenchResult> results;
+	for (const ResourceKind& kind : resourceKinds()) {
+		if (!only.empty() && only != kind.name) {
+			continue;
+		}
+		double singleThroughput = 0;
+		for (int n : threadCounts) {
+			std::vector<Plan> plans;
+			for (int t = 0; t < n; ++t) {
+				plans.push_back(makePlan(ops, mix, allocRatio, 1234u + t));
+			}
+			BenchResult r;
+			r.name = kind.name;
+			r.params = { { "threads", std::to_string(n) }, { "sizes", sizes },
+				{ "alloc_ratio", std::to_string(allocRatio) } };
+			r.opsPerRun = ops * n;
+			std::vector<double> latencies;
+			runOnce(kind, plans, latencies);   // warmup
+			latencies.clear();
+			for (int rep = 0; rep < reps; ++rep) {
+				r.samples.push_back(runOnce(kind, plans, latencies));
+			}
+
+			double throughput = r.opsPerRun / (r.summary().median / 1e9);
+			if (n == threadCounts.front()) {
+				singleThroughput = throughput / n;
+			}
+			double scaling = singleThroughput > 0 ? throughput / (n * singleThroughput) : 0;
+			double p50 = percentile(latencies, 0.50);
+			double p99 = percentile(latencies, 0.99);
+			r.metrics = { { "ops_per_sec", throughput }, { "scaling", scaling },
+				{ "p50_ns", p50 }, { "p99_ns", p99 } };
+
+			std::cout << std::left << std::setw(22) << kind.name << std::right
+				<< std::setw(8) << n << std::fixed << std::setprecision(2)
+				<< std::setw(12) << throughput / 1e6 << std::setw(12) << scaling
+				<< std::setprecision(0) << std::setw(10) << p50
+				<< std::setw(10) << p99 << '\n';
+			results.push_back(std::move(r));
+		}
+	}
+
+	if (!jsonFile.empty()) {
+		std::ofstream out{ jsonFile };
+		writeJson(out, "contention", results);
+	}
+}
@@ -0,0 +1,343 @@
+// Producer threads allocate objects from a shared resource (like the one
+// of initGlobMemResource() in Source.cpp) and hand them in batches to
+// consumer threads, which destroy them: the remote free that
+// thread-caching pools handle worst. The same run is repeated with every
+// producer destroying its own batches ("local") so the difference is the
+// cost of freeing on another thread (the queue hand-off included).
+//
+// Per resource it reports objects per second, the remote-free overhead
+// per object and the memory blowup: the most bytes the resource took from
+// upstream divided by the most bytes the objects held at once.
+//
+// build: g++ -std=c++17 -O2 -pthread bench/crossthread.cpp -o crossthread
+// usage: crossthread [--producers 2] [--consumers 2] [--objects 200000]
+//                    [--kind strings|nodes] [--strlen 40] [--batch 64]
+//                    [--reps 5] [--only name] [--json file]
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <deque>
+#include <string>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <memory_resource>
+#include "../benchmark.hpp"
+#include "../pool.hpp"
+#include "../arena.hpp"
+#include "../lockedresource.hpp"
+#include "../peakresource.hpp"
+
+// m = max(m, v) for concurrent writers
+inline void raiseMax(std::atomic<std::size_t>& m, std::size_t v) {
+	std::size_t old = m.load(std::memory_order_relaxed);
+	while (old < v && !m.compare_exchange_weak(old, v)) {
+	}
+}
+
+// what a producer hands over: a node with its key and a non-SSO value
+struct Node {
+	long key;
+	std::pmr::string value;
+	Node* next = nullptr;
+	Node(long k, const std::string& v, std::pmr::memory_resource* res)
+		: key{ k }, value{ v, res } {
+	}
+};
+
+struct Batch {
+	std::vector<void*> objects;
+	std::size_t bytes = 0;      // held by the objects, headers included
+};
+
+// bounded multi-producer multi-consumer queue of batches
+class BatchQueue
+{
+private:
+	std::mutex m;
+	std::condition_variable notEmpty, notFull;
+	std::deque<Batch> batches;
+	std::size_t capacity;
+	int producers;
+
+public:
+	BatchQueue(std::size_t cap, int p) : capacity{ cap }, producers{ p } {
+	}
+
+	void push(Batch b) {
+		std::unique_lock<std::mutex> lk{ m };
+		notFull.wait(lk, [&] { return batches.size() < capacity; });
+		batches.push_back(std::move(b));
+		notEmpty.notify_one();
+	}
+
+	void producerDone() {
+		std::lock_guard<std::mutex> lg{ m };
+		--producers;
+		notEmpty.notify_all();
+	}
+
+	// false once all producers are done and the queue is empty
+	bool pop(Batch& b) {
+		std::unique_lock<std::mutex> lk{ m };
+		notEmpty.wait(lk, [&] { return !batches.empty() || producers == 0; });
+		if (batches.empty()) {
+			return false;
+		}
+		b = std::move(batches.front());
+		batches.pop_front();
+		notFull.notify_one();
+		return true;
+	}
+};
+
+struct Config {
+	int producers = 2;
+	int consumers = 2;
+	std::size_t objects = 200000;    // per producer
+	bool nodes = false;
+	std::size_t strlen = 40;
+	std::size_t batch = 64;
+	int reps = 5;
+};
+
+class Run
+{
+private:
+	const Config& cfg;
+	std::pmr::memory_resource* res;
+	std::string text;
+	std::atomic<std::size_t> live{ 0 };
+	std::atomic<std::size_t> maxLive{ 0 };
+
+public:
+	Run(const Config& c, std::pmr::memory_resource* r)
+		: cfg{ c }, res{ r }, text(c.strlen, 'x') {
+	}
+
+	std::size_t peakLive() const {
+		return maxLive.load();
+	}
+
+	// wall time in ns
+	double operator()(bool remote) {
+		BatchQueue queue{ 64, cfg.producers };
+		std::vector<std::thread> threads;
+		auto start = std::chrono::steady_clock::now();
+		for (int p = 0; p < cfg.producers; ++p) {
+			threads.emplace_back([&, remote] {
+				for (std::size_t done = 0; done < cfg.objects; ) {
+					Batch b = produce(std::min(cfg.batch, cfg.objects - done),
+						static_cast<long>(done));
+					done += b.objects.size();
+					if (remote) {
+						queue.push(std::move(b));
+					}
+					else {
+						destroy(b);
+					}
+				}
+				queue.producerDone();
+			});
+		}
+		for (int c = 0; remote && c < cfg.consumers; ++c) {
+			threads.emplace_back([&] {
+				for (Batch b; queue.pop(b); ) {
+					destroy(b);
+				}
+			});
+		}
+		for (auto& t : threads) {
+			t.join();
+		}
+		auto stop = std::chrono::steady_clock::now();
+		return std::chrono::duration<double, std::nano>(stop - start).count();
+	}
+
+private:
+	Batch produce(std::size_t n, long first) {
+		Batch b;
+		b.objects.reserve(n);
+		for (std::size_t i = 0; i < n; ++i) {
+			if (cfg.nodes) {
+				void* p = res->allocate(sizeof(Node), alignof(Node));
+				b.objects.push_back(new (p) Node{ first + static_cast<long>(i), text, res });
+				b.bytes += sizeof(Node);
+			}
+			else {
+				void* p = res->allocate(sizeof(std::pmr::string), alignof(std::pmr::string));
+				b.objects.push_back(new (p) std::pmr::string{ text, res });
+				b.bytes += sizeof(std::pmr::string);
+			}
+			b.bytes += text.size() + 1;
+		}
+		raiseMax(maxLive, live.fetch_add(b.bytes) + b.bytes);
+		return b;
+	}
+
+	void destroy(const Batch& b) {
+		for (void* p : b.objects) {
+			if (cfg.nodes) {
+				static_cast<Node*>(p)->~Node();
+				res->deallocate(p, sizeof(Node), alignof(Node));
+			}
+			else {
+				using String = std::pmr::string;
+				static_cast<String*>(p)->~String();
+				res->deallocate(p, sizeof(String), alignof(String));
+			}
+		}
+		live.fetch_sub(b.bytes);
+	}
+};
+
+// owns the resource and the counter below it
+struct Instance {
+	PeakResource counter{ std::pmr::new_delete_resource() };
+	std::vector<std::unique_ptr<std::pmr::memory_resource>> owned;
+	std::pmr::memory_resource* res = nullptr;
+	bool counted = true;      // new_delete has no upstream to count
+};
+
+struct ResourceKind {
+	const char* name;
+	std::function<void(Instance&)> make;
+};
+
+const std::vector<ResourceKind>& resourceKinds() {
+	static const std::vector<ResourceKind> kinds{
+		{ "new_delete", [](Instance& i) {
+			i.res = std::pmr::new_delete_resource();
+			i.counted = false; } },
+		{ "synchronized_pool", [](Instance& i) {
+			i.owned.push_back(std::make_unique<std::pmr::synchronized_pool_resource>(&i.counter));
+			i.res = i.owned.back().get(); } },
+		{ "pool+mutex", [](Instance& i) {
+			i.owned.push_back(std::make_unique<Pool>(&i.counter));
+			i.owned.push_back(std::make_unique<LockedResource>(i.owned.back().get()));
+			i.res = i.owned.back().get(); } },
+		{ "arena+mutex", [](Instance& i) {    // never reuses: the worst blowup
+			i.owned.push_back(std::make_unique<Arena>(std::size_t{ 64 * 1024 }, &i.counter));
+			i.owned.push_back(std::make_unique<LockedResource>(i.owned.back().get()));
+			i.res = i.owned.back().get(); } },
+	};
+	return kinds;
+}
+
+int main(int argc, char* argv[]) {
+	Config cfg;
+	std::string only, jsonFile;
+
+	try {
+		BenchArgs args{ argc, argv };
+		while (args.next()) {
+			if (args.is("--producers")) {
+				cfg.producers = args.number(1, 1024);
+			}
+			else if (args.is("--consumers")) {
+				cfg.consumers = args.number(1, 1024);
+			}
+			else if (args.is("--objects")) {
+				cfg.objects = args.number<std::size_t>(1);
+			}
+			else if (args.is("--kind")) {
+				std::string kind = args.value();
+				if (kind != "strings" && kind != "nodes") {
+					throw std::invalid_argument{ "kind is strings or nodes" };
+				}
+				cfg.nodes = kind == "nodes";
+			}
+			else if (args.is("--strlen")) {
+				cfg.strlen = args.number<std::size_t>(0, 1 << 20);
+			}
+			else if (args.is("--batch")) {
+				cfg.batch = args.number<std::size_t>(1);
+			}
+			else if (args.is("--reps")) {
+				cfg.reps = args.number(1, 1000000);
+			}
+			else if (args.is("--only")) {
+				only = args.value();
+			}
+			else if (args.is("--json")) {
+				jsonFile = args.value();
+			}
+			else {
+				args.unknown();
+			}
+		}
+	}
+	catch (const std::invalid_argument& e) {
+		std::cerr << e.what() << '\n';
+		return 1;
+	}
+	std::cout << std::left << std::setw(20) << "resource" << std::right
+		<< std::setw(12) << "Mobj/s" << std::setw(12) << "local"
+		<< std::setw(14) << "remote ns/obj" << std::setw(10) << "blowup" << '\n';
+
+	std::vector<BenchResult> results;
+	std::size_t total = cfg.objects * cfg.producers;
+	for (const ResourceKind& kind : resourceKinds()) {
+		if (!only.empty() && only != kind.name) {
+			continue;
+		}
+		std::vector<double> remote, local;
+		double blowup = 0;
+		for (int rep = 0; rep <= cfg.reps; ++rep) {    // the first is warmup
+			for (bool isRemote : { true, false }) {
+				Instance inst;
+				kind.make(inst);
+				Run run{ cfg, inst.res };
+				double ns = run(isRemote);
+				if (rep == 0) {
+					continue;
+				}
+				(isRemote ? remote : local).push_back(ns);
+				if (isRemote && inst.counted && run.peakLive() > 0) {
+					blowup = std::max(blowup, double(inst.counter.peak()) / run.peakLive());
+				}
+			}
+		}
+
+		BenchResult r;
+		r.name = kind.name;
+		r.params = { { "producers", std::to_string(cfg.producers) },
+			{ "consumers", std::to_string(cfg.consumers) },
+			{ "kind", cfg.nodes ? "nodes" : "strings" },
+			{ "strlen", std::to_string(cfg.strlen) } };
+		r.opsPerRun = total;
+		r.samples = remote;
+		double remoteNs = summarize(remote).median;
+		double localNs = summarize(local).median;
+		double overhead = (remoteNs - localNs) / total;
+		r.metrics = { { "objects_per_sec", total / (remoteNs / 1e9) },
+			{ "local_objects_per_sec", total / (localNs / 1e9) },
+			{ "remote_free_overhead_ns", overhead } };
+		if (blowup > 0) {
+			r.metrics.emplace_back("memory_blowup", blowup);
+		}
+
+		std::cout << std::left << std::setw(20) << kind.name << std::right
+			<< std::fixed << std::setprecision(2)
+			<< std::setw(12) << total / (remoteNs / 1e3)
+			<< std::setw(12) << total / (localNs / 1e3)
+			<< std::setw(14) << overhead;
+		if (blowup > 0) {
+			std::cout << std::setw(10) << blowup << '\n';
+		}
+		else {
+			std::cout << std::setw(10) << "-" << '\n';
+		}
+		results.push_back(std::move(r));
+	}
+
+	if (!jsonFile.empty()) {
+		std::ofstream out{ jsonFile };
+		writeJson(out, "crossthread", results);
+	}
+}
@@ -0,0 +1,186 @@
+// Replays a recorded trace (see replay.hpp) or a synthetic one on a Pool
+// and reports, every --interval events, the bytes in use against the
+// bytes reserved and how fragmented the pool is, then the per size class
+// picture at the end. Bytes reserved growing while the bytes in use stay
+// flat is fragmentation; both growing together is a leak (or just more
+// live data).
+//
+// Synthetic traces:
+//   churn   rounds of short-lived strings of mixed sizes, a few of each
+//           round live on: the survivors pin partially used chunks
+//   leak    like churn, but the survivors are never freed
+//
+// build: g++ -std=c++17 -O2 bench/fragreport.cpp -o fragreport
+// usage: fragreport [trace file] [--synthetic churn|leak] [--rounds 50]
+//                   [--interval 20000] [--max-blocks n] [--largest n]
+//                   [--save file]
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <random>
+#include <memory_resource>
+#include "../benchmark.hpp"   // for BenchArgs
+#include "../pool.hpp"
+#include "../replay.hpp"
+
+// records a synthetic workload through a TraceRecorder
+Trace synthetic(const std::string& kind, int rounds) {
+	TraceRecorder rec{ std::pmr::new_delete_resource() };
+	std::mt19937 rng{ 7 };
+	std::uniform_int_distribution<std::size_t> len{ 16, 200 };
+	std::vector<std::pmr::string> survivors;
+	for (int round = 0; round < rounds; ++round) {
+		{
+			std::pmr::vector<std::pmr::string> tmp{ &rec };
+			for (int i = 0; i < 2000; ++i) {
+				tmp.emplace_back(len(rng), 'x');
+			}
+			// one in a hundred outlives the round:
+			for (std::size_t i = 0; i < tmp.size(); i += 100) {
+				survivors.emplace_back(tmp[i], &rec);
+			}
+		}
+		// with churn the survivors of older rounds die eventually, with
+		// leak they never do
+		if (kind == "churn" && survivors.size() > 200) {
+			survivors.erase(survivors.begin(), survivors.begin() + 20);
+		}
+	}
+	// the survivors still alive now were never freed as far as the
+	// trace is concerned
+	return rec.trace();
+}
+
+int main(int argc, char* argv[]) {
+	std::string file, kind = "churn", saveFile;
+	int rounds = 50;
+	std::size_t interval = 20000;
+	std::pmr::pool_options opts;
+
+	try {
+		BenchArgs args{ argc, argv };
+		while (args.next()) {
+			if (!args.isOption()) {
+				file = args.arg();
+			}
+			else if (args.is("--synthetic")) {
+				kind = args.value();
+			}
+			else if (args.is("--rounds")) {
+				rounds = args.number(1, 1000000);
+			}
+			else if (args.is("--interval")) {
+				interval = args.number<std::size_t>(1);
+			}
+			else if (args.is("--max-blocks")) {
+				opts.max_blocks_per_chunk = args.number<std::size_t>(0);
+			}
+			else if (args.is("--largest")) {
+				opts.largest_required_pool_block = args.number<std::size_t>(0);
+			}
+			else if (args.is("--save")) {
+				saveFile = args.value();
+			}
+			else {
+				args.unknown();
+			}
+		}
+	}
+	catch (const std::invalid_argument& e) {
+		std::cerr << e.what() << '\n';
+		return 1;
+	}
+
+	Trace trace;
+	try {
+		if (!file.empty()) {
+			std::ifstream in{ file };
+			if (!in) {
+				std::cerr << "can't open " << file << '\n';
+				return 1;
+			}
+			trace = loadTrace(in);
+		}
+		else if (kind == "churn" || kind == "leak") {
+			trace = synthetic(kind, rounds);
+		}
+		else {
+			std::cerr << "unknown synthetic trace " << kind << '\n';
+			return 1;
+		}
+	}
+	catch (const std::exception& e) {
+		std::cerr << e.what() << '\n';
+		return 1;
+	}
+	if (!saveFile.empty()) {
+		std::ofstream out{ saveFile };
+		saveTrace(out, trace);
+	}
+
+	Pool pool{ opts };
+	std::cout << std::setw(10) << "events" << std::setw(12) << "in use"
+		<< std::setw(12) << "reserved" << std::setw(10) << "partial"
+		<< std::setw(14) << "largest run" << '\n';
+	struct Point {
+		std::size_t inUse, reserved;
+	};
+	std::vector<Point> points;
+	auto sample = [&](std::size_t events) {
+		ResourceStats s = pool.stats();
+		PoolFragmentation f = pool.fragmentation();
+		points.push_back({ s.bytesInUse, s.bytesReserved });
+		std::cout << std::setw(10) << events << std::setw(12) << s.bytesInUse
+			<< std::setw(12) << s.bytesReserved << std::fixed << std::setprecision(1)
+			<< std::setw(9) << 100 * f.partialChunkRatio << '%'
+			<< std::setw(14) << f.largestFreeRun << '\n';
+	};
+	ReplayResult r = replay(trace, &pool, interval, sample, false);
+	sample(trace.size());
+
+	std::cout << "\nat the end of the trace:\n";
+	printStats(pool.stats());
+	printFragmentation(pool.fragmentation());
+	std::cout << r.liveBlocks << " blocks (" << r.liveBytes
+		<< " bytes) allocated by the trace were never freed\n";
+
+	// compare the second half of the run with the first: the least in use
+	// (the live data between bursts) and the most reserved
+	if (points.size() >= 4) {
+		std::size_t half = points.size() / 2;
+		auto floorOf = [&](std::size_t from, std::size_t to) {
+			std::size_t m = points[from].inUse;
+			for (std::size_t i = from; i < to; ++i) {
+				m = std::min(m, points[i].inUse);
+			}
+			return double(m);
+		};
+		auto peakOf = [&](std::size_t from, std::size_t to) {
+			std::size_t m = 0;
+			for (std::size_t i = from; i < to; ++i) {
+				m = std::max(m, points[i].reserved);
+			}
+			return double(m);
+		};
+		auto growth = [](double from, double to) {
+			return from > 0 ? 100 * (to - from) / from : 0;
+		};
+		double inUse = growth(floorOf(0, half), floorOf(half, points.size()));
+		double reserved = growth(peakOf(0, half), peakOf(half, points.size()));
+		std::cout << "second half: least in use " << std::showpos << std::setprecision(1)
+			<< inUse << "%, most reserved " << reserved << std::noshowpos << "%: ";
+		if (inUse > 5) {
+			std::cout << "live data grows (leak?)\n";
+		}
+		else if (reserved > 5) {
+			std::cout << "reserved grows without live data (fragmentation)\n";
+		}
+		else {
+			std::cout << "stable\n";
+		}
+	}
+}
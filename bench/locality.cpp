@@ -0,0 +1,260 @@
+// Builds maps, lists and unordered_maps of pmr::strings under each
+// resource and times a full traversal and random lookups, next to the
+// distances between consecutively visited elements (see locality.hpp).
+// This is what the address printouts of exampleSyncPoolBadImpl() and
+// betterExampleSyncPool() hint at, measured where it matters: with many
+// elements, keys inserted in random order and, with --noise, other
+// allocations of the program interleaved with the inserts.
+//
+// build: g++ -std=c++17 -O2 bench/locality.cpp -o locality
+// usage: locality [--elements 1000,10000,100000,1000000] [--noise 0,1]
+//                 [--reps 5] [--only resource] [--json file]
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <map>
+#include <list>
+#include <unordered_map>
+#include <memory>
+#include <functional>
+#include <algorithm>
+#include <random>
+#include <chrono>
+#include <memory_resource>
+#include "../benchmark.hpp"
+#include "../locality.hpp"
+#include "../pool.hpp"
+#include "../arena.hpp"
+
+volatile std::size_t sink;   // keeps the work from being optimized away
+
+struct ResourceKind {
+	const char* name;
+	std::function<std::unique_ptr<std::pmr::memory_resource>()> make;  // null: new_delete
+};
+
+const std::vector<ResourceKind>& resourceKinds() {
+	static const std::vector<ResourceKind> kinds{
+		{ "new_delete", [] {
+			return std::unique_ptr<std::pmr::memory_resource>{}; } },
+		{ "synchronized_pool", [] {
+			return std::make_unique<std::pmr::synchronized_pool_resource>(); } },
+		{ "unsynchronized_pool", [] {
+			return std::make_unique<std::pmr::unsynchronized_pool_resource>(); } },
+		{ "monotonic", [] {
+			return std::make_unique<std::pmr::monotonic_buffer_resource>(); } },
+		{ "Pool", [] {
+			return std::make_unique<Pool>(); } },
+		{ "Arena", [] {
+			return std::make_unique<Arena>(std::size_t{ 64 * 1024 }); } },
+	};
+	return kinds;
+}
+
+// allocations of the rest of the program, some freed again, that land
+// between the nodes when they come from the same heap
+class Noise
+{
+private:
+	std::vector<void*> blocks;
+	std::mt19937 rng{ 42 };
+
+public:
+	void step() {
+		std::uniform_int_distribution<std::size_t> size{ 16, 256 };
+		blocks.push_back(std::malloc(size(rng)));
+		if (rng() % 2 && blocks.size() > 1) {
+			std::size_t i = rng() % blocks.size();
+			std::free(blocks[i]);
+			blocks[i] = blocks.back();
+			blocks.pop_back();
+		}
+	}
+
+	~Noise() {
+		for (void* p : blocks) {
+			std::free(p);
+		}
+	}
+};
+
+using Map = std::pmr::map<long, std::pmr::string>;
+using List = std::pmr::list<std::pair<long, std::pmr::string>>;
+using UnorderedMap = std::pmr::unordered_map<long, std::pmr::string>;
+
+void insert(Map& coll, long key, const std::string& value) {
+	coll.emplace(key, value);
+}
+
+void insert(List& coll, long key, const std::string& value) {
+	coll.emplace_back(key, value);
+}
+
+void insert(UnorderedMap& coll, long key, const std::string& value) {
+	coll.emplace(key, value);
+}
+
+struct Measurement {
+	std::string container;
+	double buildNs = 0;
+	BenchResult traverse;
+	BenchResult lookup;       // no samples for list
+	DistanceHistogram distances;
+};
+
+template<typename Coll>
+Measurement measure(const char* container, std::pmr::memory_resource* res,
+	const std::vector<long>& keys, const std::vector<long>& probes, bool noise,
+	const BenchConfig& cfg, std::vector<std::pair<std::string, std::string>> params) {
+	Measurement m;
+	m.container = container;
+	params.emplace_back("container", container);
+
+	Noise junk;
+	Coll coll{ res };
+	auto start = std::chrono::steady_clock::now();
+	for (long key : keys) {
+		insert(coll, key, "Customer" + std::to_string(key) + " of the company");
+		if (noise) {
+			junk.step();
+		}
+	}
+	auto stop = std::chrono::steady_clock::now();
+	m.buildNs = std::chrono::duration<double, std::nano>(stop - start).count();
+	m.distances = distanceHistogram(coll);
+
+	m.traverse = runBenchmark("traverse", params, keys.size(), cfg, [&] {
+		std::size_t sum = 0;
+		for (const auto& elem : coll) {
+			sum += elem.first + elem.second.size();
+		}
+		sink = sum;
+	});
+	if constexpr (!std::is_same_v<Coll, List>) {
+		m.lookup = runBenchmark("lookup", params, probes.size(), cfg, [&] {
+			std::size_t sum = 0;
+			for (long key : probes) {
+				sum += coll.find(key)->second.size();
+			}
+			sink = sum;
+		});
+	}
+	return m;
+}
+
+int main(int argc, char* argv[]) {
+	std::vector<long> elements{ 1000, 10000, 100000, 1000000 };
+	std::vector<int> noiseLevels{ 0, 1 };
+	BenchConfig cfg{ 1, 5 };
+	std::string only, jsonFile;
+
+	try {
+		BenchArgs args{ argc, argv };
+		while (args.next()) {
+			if (args.is("--elements")) {
+				elements = args.numbers(1L, 100000000L);
+			}
+			else if (args.is("--noise")) {
+				noiseLevels = args.numbers(0, 100);
+			}
+			else if (args.is("--reps")) {
+				cfg.repetitions = args.number(1, 1000000);
+			}
+			else if (args.is("--only")) {
+				only = args.value();
+			}
+			else if (args.is("--json")) {
+				jsonFile = args.value();
+			}
+			else {
+				args.unknown();
+			}
+		}
+	}
+	catch (const std::invalid_argument& e) {
+		std::cerr << e.what() << '\n';
+		return 1;
+	}
+
+	std::cout << std::left << std::setw(14) << "container" << std::setw(20) << "resource"
+		<< std::right << std::setw(9) << "elements" << std::setw(6) << "noise"
+		<< std::setw(10) << "build/el" << std::setw(10) << "trav/el"
+		<< std::setw(10) << "find/op" << std::setw(8) << "<256B" << std::setw(8) << "<4K"
+		<< '\n';
+
+	std::vector<BenchResult> results;
+	for (long n : elements) {
+		std::vector<long> keys(n);
+		for (long i = 0; i < n; ++i) {
+			keys[i] = i;
+		}
+		std::mt19937 rng{ 1 };
+		std::shuffle(keys.begin(), keys.end(), rng);
+		std::vector<long> probes;
+		std::uniform_int_distribution<long> pick{ 0, n - 1 };
+		for (long i = 0; i < std::min(n, 1000000L); ++i) {
+			probes.push_back(pick(rng));
+		}
+
+		for (const ResourceKind& kind : resourceKinds()) {
+			if (!only.empty() && only != kind.name) {
+				continue;
+			}
+			for (int noise : noiseLevels) {
+				std::vector<std::pair<std::string, std::string>> params{
+					{ "resource", kind.name }, { "elements", std::to_string(n) },
+					{ "noise", std::to_string(noise) } };
+				std::vector<Measurement> ms;
+				// a fresh resource for every container:
+				auto run = [&](auto tag, const char* container) {
+					auto owned = kind.make();
+					std::pmr::memory_resource* res = owned ? owned.get()
+						: std::pmr::new_delete_resource();
+					ms.push_back(measure<decltype(tag)>(container, res, keys, probes,
+						noise != 0, cfg, params));
+				};
+				run(Map{}, "map");
+				run(List{}, "list");
+				run(UnorderedMap{}, "unordered_map");
+
+				for (Measurement& m : ms) {
+					double lookup = m.lookup.samples.empty() ? 0
+						: m.lookup.summary().median / m.lookup.opsPerRun;
+					std::cout << std::left << std::setw(14) << m.container
+						<< std::setw(20) << kind.name << std::right << std::setw(9) << n
+						<< std::setw(6) << noise << std::fixed << std::setprecision(1)
+						<< std::setw(10) << m.buildNs / n
+						<< std::setw(10) << m.traverse.summary().median / n
+						<< std::setw(10) << lookup << std::setprecision(0)
+						<< std::setw(7) << 100 * m.distances.shareBelow(256) << '%'
+						<< std::setw(7) << 100 * m.distances.shareBelow(4096) << '%' << '\n';
+
+					std::vector<std::pair<std::string, double>> metrics{
+						{ "build_ns_per_element", m.buildNs / n },
+						{ "share_below_256", m.distances.shareBelow(256) },
+						{ "share_below_4096", m.distances.shareBelow(4096) } };
+					for (std::size_t k = 0; k < DistanceHistogram::buckets; ++k) {
+						if (m.distances.count[k] > 0) {
+							metrics.emplace_back("distance_below_2^" + std::to_string(k),
+								double(m.distances.count[k]));
+						}
+					}
+					// after those of runBenchmark(), perf counters and page faults
+					m.traverse.metrics.insert(m.traverse.metrics.end(),
+						metrics.begin(), metrics.end());
+					results.push_back(std::move(m.traverse));
+					if (!m.lookup.samples.empty()) {
+						results.push_back(std::move(m.lookup));
+					}
+				}
+			}
+		}
+	}
+
+	if (!jsonFile.empty()) {
+		std::ofstream out{ jsonFile };
+		writeJson(out, "locality", results);
+	}
+}
@@ -0,0 +1,249 @@
+// Finds pool_options for a workload: replays a recorded trace (see
+// replay.hpp) or the allocations of one of the workloads of scenarios.hpp
+// on the standard pools and the in-tree Pool with every combination of the
+// candidate options, and recommends the configuration that is fastest or
+// holds the least memory from upstream at its peak, as the objective says.
+// Within --slack percent of the best on the objective the other measure
+// decides, so a noisy few percent of time don't cost half the memory.
+// Candidates that the pools round to the same effective options are run
+// once. The recommendation is printed as code to paste.
+//
+// build: g++ -std=c++17 -O2 bench/pooltune.cpp -o pooltune
+// usage: pooltune [trace file] [--workload map] [--elements 1000] [--strlen 21]
+//                 [--objective time|memory] [--slack 5] [--pools unsync,sync,pool]
+//                 [--largest 256,1024,4096,16384] [--max-blocks 16,64,256,1024,4096]
+//                 [--reps 20] [--warmup 3] [--json file]
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <memory>
+#include <algorithm>
+#include <memory_resource>
+#include "../benchmark.hpp"
+#include "../scenarios.hpp"
+#include "../replay.hpp"
+#include "../pool.hpp"
+#include "../peakresource.hpp"
+
+// a pool of one kind, as the options make it
+struct PoolKind {
+	const char* name;
+	const char* type;     // for the recommendation
+	std::unique_ptr<std::pmr::memory_resource> (*make)(const std::pmr::pool_options&,
+		std::pmr::memory_resource*);
+	std::pmr::pool_options (*options)(const std::pmr::memory_resource*);
+};
+
+template<typename P>
+PoolKind kind(const char* name, const char* type) {
+	return PoolKind{ name, type,
+		[](const std::pmr::pool_options& o, std::pmr::memory_resource* us)
+			-> std::unique_ptr<std::pmr::memory_resource> {
+			return std::make_unique<P>(o, us);
+		},
+		[](const std::pmr::memory_resource* r) {
+			return static_cast<const P*>(r)->options();
+		} };
+}
+
+const std::vector<PoolKind>& poolKinds() {
+	static const std::vector<PoolKind> list{
+		kind<std::pmr::unsynchronized_pool_resource>("unsync",
+			"std::pmr::unsynchronized_pool_resource"),
+		kind<std::pmr::synchronized_pool_resource>("sync",
+			"std::pmr::synchronized_pool_resource"),
+		kind<Pool>("pool", "Pool"),
+	};
+	return list;
+}
+
+struct Candidate {
+	const PoolKind* kind;
+	std::pmr::pool_options opts;   // effective, as the pool reports them
+	double median = 0;             // ns per replay
+	std::size_t peak = 0;          // bytes from upstream
+};
+
+int main(int argc, char* argv[]) {
+	std::string file, workloadName = "map", objective = "time", jsonFile;
+	int elements = 1000;
+	std::size_t strlen = 21;
+	double slack = 5;
+	std::vector<std::string> pools{ "unsync", "sync", "pool" };
+	std::vector<std::size_t> largest{ 256, 1024, 4096, 16384 };
+	std::vector<std::size_t> maxBlocks{ 16, 64, 256, 1024, 4096 };
+	BenchConfig cfg;
+	cfg.counters = false;
+	cfg.osStats = false;
+
+	try {
+		BenchArgs args{ argc, argv };
+		while (args.next()) {
+			if (!args.isOption()) {
+				file = args.arg();
+			}
+			else if (args.is("--workload")) {
+				workloadName = args.value();
+			}
+			else if (args.is("--elements")) {
+				elements = args.number(1, 100000000);
+			}
+			else if (args.is("--strlen")) {
+				strlen = args.number<std::size_t>(0, 1 << 20);
+			}
+			else if (args.is("--objective")) {
+				objective = args.value();
+			}
+			else if (args.is("--slack")) {
+				slack = args.number(0.0, 1000.0);
+			}
+			else if (args.is("--pools")) {
+				pools = args.list();
+			}
+			else if (args.is("--largest")) {
+				largest = args.numbers<std::size_t>(1);
+			}
+			else if (args.is("--max-blocks")) {
+				maxBlocks = args.numbers<std::size_t>(1);
+			}
+			else if (args.is("--reps")) {
+				cfg.repetitions = args.number(1, 1000000);
+			}
+			else if (args.is("--warmup")) {
+				cfg.warmup = args.number(0, 1000000);
+			}
+			else if (args.is("--json")) {
+				jsonFile = args.value();
+			}
+			else {
+				args.unknown();
+			}
+		}
+	}
+	catch (const std::invalid_argument& e) {
+		std::cerr << e.what() << '\n';
+		return 1;
+	}
+	if (objective != "time" && objective != "memory") {
+		std::cerr << "objective is time or memory\n";
+		return 1;
+	}
+
+	// the workload to tune for, as a trace
+	Trace trace;
+	std::string source = file;
+	if (!file.empty()) {
+		std::ifstream in{ file };
+		if (!in) {
+			std::cerr << "can't open " << file << '\n';
+			return 1;
+		}
+		try {
+			trace = loadTrace(in);
+		}
+		catch (const std::exception& e) {
+			std::cerr << e.what() << '\n';
+			return 1;
+		}
+	}
+	else {
+		const scenarios::Workload* workload = nullptr;
+		for (const auto& w : scenarios::workloads()) {
+			workload = workloadName == w.name ? &w : workload;
+		}
+		if (workload == nullptr) {
+			std::cerr << "unknown workload " << workloadName << '\n';
+			return 1;
+		}
+		TraceRecorder rec{ std::pmr::new_delete_resource() };
+		workload->run(&rec, elements, strlen);
+		trace = rec.trace();
+		source = workloadName + ", " + std::to_string(elements) + " elements";
+	}
+
+	std::vector<Candidate> candidates;
+	std::vector<BenchResult> results;
+	for (const PoolKind& k : poolKinds()) {
+		if (std::find(pools.begin(), pools.end(), k.name) == pools.end()) {
+			continue;
+		}
+		for (std::size_t l : largest) {
+			for (std::size_t m : maxBlocks) {
+				PeakResource probe{ std::pmr::new_delete_resource() };
+				std::pmr::pool_options opts = k.options(k.make({ m, l }, &probe).get());
+				bool seen = false;
+				for (const Candidate& c : candidates) {
+					seen = seen || (c.kind == &k
+						&& c.opts.largest_required_pool_block == opts.largest_required_pool_block
+						&& c.opts.max_blocks_per_chunk == opts.max_blocks_per_chunk);
+				}
+				if (seen) {
+					continue;
+				}
+
+				// every replay on a fresh pool, so chunks grow as they would
+				PeakResource upstream{ std::pmr::new_delete_resource() };
+				BenchResult r = runBenchmark(k.name, {
+					{ "largest_required_pool_block", std::to_string(opts.largest_required_pool_block) },
+					{ "max_blocks_per_chunk", std::to_string(opts.max_blocks_per_chunk) } },
+					trace.size(), cfg, [&] {
+						auto pool = k.make(opts, &upstream);
+						replay(trace, pool.get());
+					});
+				r.peakBytes = upstream.peak();
+				candidates.push_back({ &k, opts, r.summary().median, r.peakBytes });
+				results.push_back(std::move(r));
+			}
+		}
+	}
+	if (candidates.empty()) {
+		std::cerr << "no candidates (see --pools)\n";
+		return 1;
+	}
+
+	// best on the objective, then the best on the other measure of those
+	// within the slack of it
+	auto primary = [&](const Candidate& c) {
+		return objective == "time" ? c.median : double(c.peak);
+	};
+	auto secondary = [&](const Candidate& c) {
+		return objective == "time" ? double(c.peak) : c.median;
+	};
+	std::sort(candidates.begin(), candidates.end(), [&](const Candidate& a, const Candidate& b) {
+		return primary(a) < primary(b);
+	});
+	double limit = primary(candidates.front()) * (1 + slack / 100);
+	const Candidate* best = &candidates.front();
+	for (const Candidate& c : candidates) {
+		if (primary(c) <= limit && secondary(c) < secondary(*best)) {
+			best = &c;
+		}
+	}
+
+	std::cout << "tuning for " << source << " (" << trace.size() << " events), objective "
+		<< objective << ", slack " << slack << "%\n\n";
+	std::cout << std::setw(8) << "pool" << std::setw(10) << "largest" << std::setw(12)
+		<< "max blocks" << std::setw(14) << "median ns" << std::setw(14) << "peak bytes" << '\n';
+	for (const Candidate& c : candidates) {
+		std::cout << std::setw(8) << c.kind->name
+			<< std::setw(10) << c.opts.largest_required_pool_block
+			<< std::setw(12) << c.opts.max_blocks_per_chunk << std::fixed << std::setprecision(0)
+			<< std::setw(14) << c.median << std::setw(14) << c.peak
+			<< (&c == best ? "  <- recommended" : "") << '\n';
+	}
+
+	std::cout << "\n// " << best->kind->name << ": " << std::setprecision(0) << best->median
+		<< " ns, " << best->peak << " bytes from upstream at the peak\n"
+		<< "std::pmr::pool_options opts{ " << best->opts.max_blocks_per_chunk
+		<< ", " << best->opts.largest_required_pool_block
+		<< " };   // max_blocks_per_chunk, largest_required_pool_block\n"
+		<< best->kind->type << " pool{ opts };\n";
+
+	if (!jsonFile.empty()) {
+		std::ofstream out{ jsonFile };
+		writeJson(out, "pooltune", results);
+	}
+}
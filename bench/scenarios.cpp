@@ -0,0 +1,77 @@
+// Times every example of Source.cpp (see scenarios.hpp) for a range of
+// element counts, with allocations and peak heap bytes per run and the
+// perf counters (cycles, cache and TLB misses, ...) the system permits.
+//
+// build: g++ -std=c++17 -O2 bench/scenarios.cpp -o scenarios
+// usage: scenarios [--elements 100,1000,10000] [--reps 20] [--warmup 3]
+//                  [--counters on|off] [--only name] [--json file]
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include "../tracknew.hpp"
+#include "../benchmark.hpp"
+#include "../scenarios.hpp"
+
+volatile std::size_t sink;   // keeps the work from being optimized away
+
+int main(int argc, char* argv[]) {
+	std::vector<int> elements{ 100, 1000, 10000 };
+	BenchConfig cfg;
+	std::string only, jsonFile;
+
+	try {
+		BenchArgs args{ argc, argv };
+		while (args.next()) {
+			if (args.is("--elements")) {
+				elements = args.numbers(1, 100000000);
+			}
+			else if (args.is("--reps")) {
+				cfg.repetitions = args.number(1, 1000000);
+			}
+			else if (args.is("--warmup")) {
+				cfg.warmup = args.number(0, 1000000);
+			}
+			else if (args.is("--counters")) {
+				cfg.counters = args.value() != "off";
+			}
+			else if (args.is("--only")) {
+				only = args.value();
+			}
+			else if (args.is("--json")) {
+				jsonFile = args.value();
+			}
+			else {
+				args.unknown();
+			}
+		}
+	}
+	catch (const std::invalid_argument& e) {
+		std::cerr << e.what() << '\n';
+		return 1;
+	}
+
+	if (cfg.counters && !PerfCounters{}.available()) {
+		std::cerr << "no perf counters permitted (see perf_event_paranoid)\n";
+	}
+	std::vector<BenchResult> results;
+	printHeader();
+	for (const auto& sc : scenarios::all()) {
+		if (!only.empty() && only != sc.name) {
+			continue;
+		}
+		for (int num : elements) {
+			results.push_back(runBenchmark(sc.name,
+				{ { "elements", std::to_string(num) } },
+				static_cast<std::size_t>(num) * sc.rounds, cfg,
+				[&] { sink = sc.run(num); }));
+			printResult(results.back());
+		}
+	}
+
+	if (!jsonFile.empty()) {
+		std::ofstream out{ jsonFile };
+		writeJson(out, "scenarios", results);
+	}
+}
@@ -0,0 +1,105 @@
+// Compares std::pmr::vector<std::pmr::string> with the same containers on
+// static_allocator, running the workload of dontAllocateOnTheHeapAtAll()
+// (1000 non-SSO strings) on several resources.
+//
+// build: g++ -std=c++17 -O2 bench/staticallocator.cpp -o staticallocator
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <array>
+#include <algorithm>
+#include <chrono>
+#include <memory_resource>
+#include "../tracknew.hpp"
+#include "../arena.hpp"
+#include "../pool.hpp"
+#include "../staticarena.hpp"
+#include "../staticallocator.hpp"
+
+template<typename Resource>
+using StaticString = std::basic_string<char, std::char_traits<char>,
+	static_allocator<char, Resource>>;
+
+template<typename Resource>
+using StaticVector = std::vector<StaticString<Resource>,
+	static_allocator<StaticString<Resource>, Resource>>;
+
+constexpr int numElems = 1000;
+constexpr int numRuns = 2000;
+
+volatile std::size_t sink;   // keeps the work from being optimized away
+
+// run f numRuns times and print the median time per run
+template<typename F>
+void measure(const char* name, F f) {
+	std::vector<double> ns;
+	ns.reserve(numRuns);
+	f();   // warmup
+	TrackNew::reset();
+	for (int r = 0; r < numRuns; ++r) {
+		auto start = std::chrono::steady_clock::now();
+		f();
+		auto stop = std::chrono::steady_clock::now();
+		ns.push_back(std::chrono::duration<double, std::nano>(stop - start).count());
+	}
+	std::sort(ns.begin(), ns.end());
+	std::cout << std::left << std::setw(36) << name << std::right
+		<< std::setw(10) << std::fixed << std::setprecision(0) << ns[ns.size() / 2]
+		<< " ns/run  " << std::setw(8) << std::setprecision(2)
+		<< ns[ns.size() / 2] / numElems << " ns/elem  ";
+	TrackNew::status();
+}
+
+template<typename Coll>
+void fill(Coll& coll) {
+	for (int i = 0; i < numElems; ++i) {
+		coll.emplace_back("just a non-SSO string");
+	}
+	sink = coll.size() + coll.back().size();
+}
+
+int main() {
+	measure("monotonic_buffer_resource pmr", [] {
+		std::array<std::byte, 200000> buf;
+		std::pmr::monotonic_buffer_resource pool{ buf.data(), buf.size() };
+		std::pmr::vector<std::pmr::string> coll{ &pool };
+		fill(coll);
+	});
+
+	measure("StaticArena pmr", [] {
+		StaticArena<200000> arena;
+		std::pmr::vector<std::pmr::string> coll{ &arena };
+		fill(coll);
+	});
+	measure("StaticArena static_allocator", [] {
+		StaticArena<200000> arena;
+		StaticVector<StaticArena<200000>> coll{ &arena };
+		fill(coll);
+	});
+
+	measure("Arena pmr", [] {
+		std::array<std::byte, 200000> buf;
+		Arena arena{ buf.data(), buf.size() };
+		std::pmr::vector<std::pmr::string> coll{ &arena };
+		fill(coll);
+	});
+	measure("Arena static_allocator", [] {
+		std::array<std::byte, 200000> buf;
+		Arena arena{ buf.data(), buf.size() };
+		StaticVector<Arena> coll{ &arena };
+		fill(coll);
+	});
+
+	// the pool comes from the heap, keep it warm between runs:
+	static Pool pool;
+	measure("Pool pmr", [] {
+		std::pmr::vector<std::pmr::string> coll{ &pool };
+		fill(coll);
+	});
+	measure("Pool static_allocator", [] {
+		StaticVector<Pool> coll{ &pool };
+		fill(coll);
+	});
+}
@@ -0,0 +1,424 @@
+#ifndef BENCHMARK_HPP
+#define BENCHMARK_HPP
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <utility>   // for std::pair
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>     // for std::strtoll(), std::strtoull() and std::strtod()
+#include <cerrno>
+#include <cctype>      // for std::isdigit()
+#include <limits>
+#include <sstream>
+#include <stdexcept>   // for std::invalid_argument
+#include <type_traits>
+#include "perfcounters.hpp"
+#include "osstats.hpp"
+
+// A small benchmark harness: runs a function a few times to warm up, then
+// times a number of repetitions and summarizes them. Include tracknew.hpp
+// before this header (in the one file that includes tracknew.hpp at all)
+// to also get allocations and peak bytes per run. Where perf_event_open()
+// is permitted the counters of perfcounters.hpp go into the metrics of
+// each result, per run, next to the page faults and resident set growth
+// of osstats.hpp. The faults of the very first run (warmup or not) are
+// reported separately: they show the first-touch cost that later runs on
+// already committed pages don't pay. BenchArgs reads the command lines of
+// the benchmarks.
+
+struct Summary {
+	double mean = 0;
+	double median = 0;
+	double stddev = 0;
+	double ciLow = 0;     // 95% confidence interval of the mean
+	double ciHigh = 0;
+	double min = 0;
+	double max = 0;
+};
+
+// two-sided 95% quantile of Student's t for n - 1 degrees of freedom
+inline double tQuantile95(std::size_t n) {
+	static const double table[] = { 0, 12.706, 4.303, 3.182, 2.776, 2.571,
+		2.447, 2.365, 2.306, 2.262, 2.228, 2.201, 2.179, 2.160, 2.145, 2.131,
+		2.120, 2.110, 2.101, 2.093, 2.086, 2.080, 2.074, 2.069, 2.064, 2.060,
+		2.056, 2.052, 2.048, 2.045, 2.042 };
+	std::size_t df = n > 0 ? n - 1 : 0;
+	return df < sizeof(table) / sizeof(table[0]) ? table[df] : 1.960;
+}
+
+inline Summary summarize(std::vector<double> v) {
+	Summary s;
+	if (v.empty()) {
+		return s;
+	}
+	std::sort(v.begin(), v.end());
+	std::size_t n = v.size();
+	s.min = v.front();
+	s.max = v.back();
+	s.median = n % 2 ? v[n / 2] : (v[n / 2 - 1] + v[n / 2]) / 2;
+	double sum = 0;
+	for (double x : v) {
+		sum += x;
+	}
+	s.mean = sum / n;
+	double sq = 0;
+	for (double x : v) {
+		sq += (x - s.mean) * (x - s.mean);
+	}
+	s.stddev = n > 1 ? std::sqrt(sq / (n - 1)) : 0;
+	double half = n > 1 ? tQuantile95(n) * s.stddev / std::sqrt(double(n)) : 0;
+	s.ciLow = s.mean - half;
+	s.ciHigh = s.mean + half;
+	return s;
+}
+
+// q-th quantile (0..1) by the nearest rank, v gets sorted
+inline double percentile(std::vector<double>& v, double q) {
+	if (v.empty()) {
+		return 0;
+	}
+	std::sort(v.begin(), v.end());
+	std::size_t rank = static_cast<std::size_t>(std::ceil(q * v.size()));
+	return v[rank > 0 ? rank - 1 : 0];
+}
+
+struct BenchResult {
+	std::string name;
+	std::vector<std::pair<std::string, std::string>> params;
+	std::size_t opsPerRun = 1;        // e.g. elements handled by one run
+	std::vector<double> samples;      // ns per run
+	double allocsPerRun = 0;          // global new calls, needs tracknew.hpp
+	double bytesPerRun = 0;
+	std::size_t peakBytes = 0;        // most bytes in use during one run
+	std::vector<std::pair<std::string, double>> metrics;   // benchmark specific
+
+	Summary summary() const {
+		return summarize(samples);
+	}
+};
+
+struct BenchConfig {
+	int warmup = 3;
+	int repetitions = 20;
+	bool counters = true;   // perf counters where available
+	bool osStats = true;    // page faults, RSS and PSS
+};
+
+// setup() runs before every run of f(), untimed and outside the
+// counted allocations, e.g. to build a fresh resource for it
+template<typename S, typename F>
+BenchResult runBenchmark(const std::string& name,
+	std::vector<std::pair<std::string, std::string>> params,
+	std::size_t opsPerRun, const BenchConfig& cfg, S setup, F f) {
+	BenchResult r;
+	r.name = name;
+	r.params = std::move(params);
+	r.opsPerRun = opsPerRun ? opsPerRun : 1;
+	r.samples.reserve(cfg.repetitions);
+
+	OsStats first, sum;
+	for (int i = 0; i < cfg.warmup; ++i) {
+		setup();
+		OsStats::Scope os;
+		f();
+		if (i == 0) {
+			first = os.delta();
+		}
+	}
+	PerfCounters pc;
+	for (int i = 0; i < cfg.repetitions; ++i) {
+		setup();
+		OsStats::Scope os;
+		if (cfg.counters) {
+			pc.start();
+		}
+#ifdef TRACKNEW_HPP
+		TrackNew::Scope scope;
+#endif
+		auto start = std::chrono::steady_clock::now();
+		f();
+		auto stop = std::chrono::steady_clock::now();
+		r.samples.push_back(std::chrono::duration<double, std::nano>(stop - start).count());
+		if (cfg.counters) {
+			pc.stop();
+		}
+		OsStats d = os.delta();
+		if (i == 0 && cfg.warmup <= 0) {
+			first = d;
+		}
+		sum.minorFaults += d.minorFaults;
+		sum.majorFaults += d.majorFaults;
+		sum.rss += d.rss;
+#ifdef TRACKNEW_HPP
+		r.allocsPerRun += scope.allocations();
+		r.bytesPerRun += scope.bytes();
+		if (scope.peak() > r.peakBytes) {
+			r.peakBytes = scope.peak();
+		}
+#endif
+	}
+	if (cfg.repetitions > 0) {
+		r.allocsPerRun /= cfg.repetitions;
+		r.bytesPerRun /= cfg.repetitions;
+		if (cfg.counters) {
+			for (const auto& [counter, value] : pc.values()) {
+				r.metrics.emplace_back(counter, value / cfg.repetitions);
+			}
+		}
+		if (cfg.osStats) {
+			OsStats now = OsStats::now(true);
+			r.metrics.emplace_back("first_run_minor_faults", double(first.minorFaults));
+			r.metrics.emplace_back("first_run_rss_growth", double(first.rss));
+			r.metrics.emplace_back("minor_faults", double(sum.minorFaults) / cfg.repetitions);
+			r.metrics.emplace_back("major_faults", double(sum.majorFaults) / cfg.repetitions);
+			r.metrics.emplace_back("rss_growth", double(sum.rss) / cfg.repetitions);
+			r.metrics.emplace_back("rss", double(now.rss));
+			r.metrics.emplace_back("pss", double(now.pss));
+		}
+	}
+	return r;
+}
+
+template<typename F>
+BenchResult runBenchmark(const std::string& name,
+	std::vector<std::pair<std::string, std::string>> params,
+	std::size_t opsPerRun, const BenchConfig& cfg, F f) {
+	return runBenchmark(name, std::move(params), opsPerRun, cfg, [] {}, f);
+}
+
+inline void printHeader(std::ostream& os = std::cout) {
+	os << std::left << std::setw(28) << "benchmark" << std::setw(20) << "params"
+		<< std::right << std::setw(12) << "ns/run" << std::setw(10) << "+-95%"
+		<< std::setw(10) << "ns/op" << std::setw(12) << "allocs/run"
+		<< std::setw(12) << "bytes/run" << std::setw(12) << "peak bytes" << '\n';
+}
+
+inline void printResult(const BenchResult& r, std::ostream& os = std::cout) {
+	Summary s = r.summary();
+	std::string params;
+	for (const auto& [key, value] : r.params) {
+		params += (params.empty() ? "" : " ") + key + "=" + value;
+	}
+	auto oldFlags = os.flags();
+	auto oldPrecision = os.precision();
+	os << std::left << std::setw(28) << r.name << std::setw(20) << params
+		<< std::right << std::fixed << std::setprecision(0)
+		<< std::setw(12) << s.mean << std::setw(10) << (s.ciHigh - s.mean)
+		<< std::setprecision(2) << std::setw(10) << s.mean / r.opsPerRun
+		<< std::setprecision(1) << std::setw(12) << r.allocsPerRun
+		<< std::setprecision(0) << std::setw(12) << r.bytesPerRun
+		<< std::setw(12) << r.peakBytes << '\n';
+	if (!r.metrics.empty()) {
+		os << std::string(4, ' ');
+		for (const auto& [metric, value] : r.metrics) {
+			os << ' ' << metric << '=' << value;
+		}
+		os << '\n';
+	}
+	os.flags(oldFlags);
+	os.precision(oldPrecision);
+}
+
+inline void writeJsonString(std::ostream& os, const std::string& s) {
+	os << '"';
+	for (char c : s) {
+		switch (c) {
+		case '"': os << "\\\""; break;
+		case '\\': os << "\\\\"; break;
+		case '\n': os << "\\n"; break;
+		case '\t': os << "\\t"; break;
+		default: os << c;
+		}
+	}
+	os << '"';
+}
+
+// {"benchmark": ..., "results": [{"name", "params", "samples_ns", ...}]}
+inline void writeJson(std::ostream& os, const std::string& benchmark,
+	const std::vector<BenchResult>& results) {
+	os << "{\n  \"benchmark\": ";
+	writeJsonString(os, benchmark);
+	os << ",\n  \"results\": [";
+	auto oldPrecision = os.precision(10);
+	for (std::size_t i = 0; i < results.size(); ++i) {
+		const BenchResult& r = results[i];
+		Summary s = r.summary();
+		os << (i ? ",\n" : "\n") << "    {\"name\": ";
+		writeJsonString(os, r.name);
+		os << ", \"params\": {";
+		for (std::size_t j = 0; j < r.params.size(); ++j) {
+			os << (j ? ", " : "");
+			writeJsonString(os, r.params[j].first);
+			os << ": ";
+			writeJsonString(os, r.params[j].second);
+		}
+		os << "},\n     \"ops_per_run\": " << r.opsPerRun
+			<< ", \"mean_ns\": " << s.mean << ", \"median_ns\": " << s.median
+			<< ", \"stddev_ns\": " << s.stddev
+			<< ", \"ci95_ns\": [" << s.ciLow << ", " << s.ciHigh << "]"
+			<< ",\n     \"allocs_per_run\": " << r.allocsPerRun
+			<< ", \"bytes_per_run\": " << r.bytesPerRun
+			<< ", \"peak_bytes\": " << r.peakBytes;
+		if (!r.metrics.empty()) {
+			os << ",\n     \"metrics\": {";
+			for (std::size_t j = 0; j < r.metrics.size(); ++j) {
+				os << (j ? ", " : "");
+				writeJsonString(os, r.metrics[j].first);
+				os << ": " << r.metrics[j].second;
+			}
+			os << "}";
+		}
+		os << ",\n     \"samples_ns\": [";
+		for (std::size_t j = 0; j < r.samples.size(); ++j) {
+			os << (j ? ", " : "") << r.samples[j];
+		}
+		os << "]}";
+	}
+	os << "\n  ]\n}\n";
+	os.precision(oldPrecision);
+}
+
+// The command line of a benchmark: options with a value ("--reps 5"),
+// flags and other arguments (e.g. files). Numbers have to be whole and in
+// their range, lists (comma separated) must not be empty. What doesn't fit
+// throws std::invalid_argument with a message for the user:
+//
+//   BenchArgs args{ argc, argv };
+//   while (args.next()) {
+//       if (args.is("--reps")) {
+//           cfg.repetitions = args.number(1, 1000000);
+//       }
+//       else if (args.is("--json")) {
+//           jsonFile = args.value();
+//       }
+//       else {
+//           args.unknown();
+//       }
+//   }
+class BenchArgs
+{
+private:
+	int argc;
+	char** argv;
+	int i = 0;
+	std::string cur;
+
+public:
+	BenchArgs(int c, char* v[])
+		: argc{ c }, argv{ v } {
+	}
+
+	// moves on to the next argument, false after the last
+	bool next() {
+		if (++i >= argc) {
+			return false;
+		}
+		cur = argv[i];
+		return true;
+	}
+
+	const std::string& arg() const {
+		return cur;
+	}
+
+	bool is(const char* name) const {
+		return cur == name;
+	}
+
+	// starts with "--", the others are e.g. file names
+	bool isOption() const {
+		return cur.rfind("--", 0) == 0;
+	}
+
+	// the value of the current option
+	std::string value() {
+		if (i + 1 >= argc) {
+			throw std::invalid_argument{ "missing value for " + cur };
+		}
+		return argv[++i];
+	}
+
+	template<typename T>
+	T number(T min, T max = std::numeric_limits<T>::max()) {
+		return parse(value(), min, max);
+	}
+
+	template<typename T>
+	std::vector<T> numbers(T min, T max = std::numeric_limits<T>::max()) {
+		std::vector<T> ns;
+		for (const std::string& part : list()) {
+			ns.push_back(parse(part, min, max));
+		}
+		return ns;
+	}
+
+	std::vector<std::string> list() {
+		std::string v = value();
+		std::vector<std::string> parts;
+		std::istringstream is{ v };
+		for (std::string part; std::getline(is, part, ','); ) {
+			if (part.empty()) {
+				throw std::invalid_argument{ "empty item in '" + v + "' for " + cur };
+			}
+			parts.push_back(part);
+		}
+		if (parts.empty()) {
+			throw std::invalid_argument{ "empty list for " + cur };
+		}
+		return parts;
+	}
+
+	[[noreturn]] void unknown() const {
+		throw std::invalid_argument{ "unknown option " + cur };
+	}
+
+private:
+	template<typename T>
+	T parse(const std::string& s, T min, T max) const {
+		static_assert(std::is_arithmetic_v<T>, "numbers only");
+		// strto*() skip blanks and wrap a '-' around for unsigned types
+		bool negative = false;
+		if constexpr (std::is_signed_v<T>) {
+			negative = min < 0;
+		}
+		bool ok = !s.empty() && (std::isdigit(static_cast<unsigned char>(s[0]))
+			|| (s[0] == '-' && negative) || (s[0] == '.' && std::is_floating_point_v<T>));
+		char* end = nullptr;
+		errno = 0;
+		T n{};
+		if constexpr (std::is_floating_point_v<T>) {
+			double d = std::strtod(s.c_str(), &end);
+			ok = ok && d >= min && d <= max;   // NaN fails as well
+			n = static_cast<T>(d);
+		}
+		else if constexpr (std::is_signed_v<T>) {
+			long long ll = std::strtoll(s.c_str(), &end, 10);
+			ok = ok && ll >= min && ll <= max;
+			n = static_cast<T>(ll);
+		}
+		else {
+			unsigned long long ull = std::strtoull(s.c_str(), &end, 10);
+			ok = ok && ull >= min && ull <= max;
+			n = static_cast<T>(ull);
+		}
+		if (!ok || errno != 0 || end != s.c_str() + s.size()) {
+			std::ostringstream msg;
+			msg << "bad value '" << s << "' for " << cur << ", expected a number ";
+			if (max == std::numeric_limits<T>::max()) {
+				msg << "of at least " << min;
+			}
+			else {
+				msg << "from " << min << " to " << max;
+			}
+			throw std::invalid_argument{ msg.str() };
+		}
+		return n;
+	}
+};
+
+#endif // BENCHMARK_HPP
@@ -0,0 +1,187 @@
+#ifndef BUDGET_HPP
+#define BUDGET_HPP
+
+#include <memory_resource>
+#include <atomic>
+#include <mutex>
+#include <functional>
+#include <unordered_set>
+#include <utility>   // for std::move()
+#include <new>       // for std::bad_alloc
+#include "introspect.hpp"
+#include "threaddefault.hpp"
+
+// Admission control: passes requests on to upstream as long as the bytes
+// it handed out stay within its limit. Budgets nest by chaining them, a
+// request's budget taking its memory from that of its subsystem, which
+// takes it from the process budget:
+//
+//   BudgetResource process{ 512 << 20 };
+//   BudgetResource subsystem{ 64 << 20, &process };
+//   BudgetResource request{ 1 << 20, BudgetResource::OverBudget::fallback, &subsystem };
+//
+// Every level charges what passes through it, so a request has to fit
+// into all of them (with pools in between, the upper levels see their
+// chunks). What happens to a request over the limit is the policy:
+//   fail       throw std::bad_alloc, like null_memory_resource() does for
+//              everything (see exampleNMR())
+//   callback   ask the onOverBudget() function, which may free memory or
+//              raise the limit and return true to try again, or return
+//              false to fail
+//   fallback   take it from upstream anyway without charging it here, the
+//              levels above still decide
+// The accounting is atomic, a budget can be shared by threads if its
+// upstream can. Blocks given out over the limit are remembered under a
+// mutex, so deallocate() knows not to refund them.
+class BudgetResource final : public introspectable_resource
+{
+public:
+	enum class OverBudget { fail, callback, fallback };
+
+private:
+	std::pmr::memory_resource* upstream;
+	OverBudget policy;
+	std::function<bool(std::size_t bytes)> callback;
+	std::atomic<std::size_t> maxBytes;
+	std::atomic<std::size_t> usedBytes{ 0 };
+	std::atomic<std::size_t> peakBytes{ 0 };
+	std::atomic<std::size_t> usedBlocks{ 0 };
+	std::atomic<std::size_t> numRejected{ 0 };
+	std::atomic<std::size_t> numFallbacks{ 0 };
+	std::atomic<std::size_t> liveFallbacks{ 0 };
+	std::atomic<std::size_t> fallbackBytes{ 0 };
+	mutable std::mutex m;                 // guards fallbacks
+	std::unordered_set<void*> fallbacks;  // given out over the limit
+
+public:
+	explicit BudgetResource(std::size_t limit,
+		std::pmr::memory_resource* us = get_thread_default())
+		: BudgetResource{ limit, OverBudget::fail, us } {
+	}
+
+	BudgetResource(std::size_t limit, OverBudget p,
+		std::pmr::memory_resource* us = get_thread_default())
+		: upstream{ us }, policy{ p }, maxBytes{ limit } {
+	}
+
+	BudgetResource(const BudgetResource&) = delete;
+	BudgetResource& operator=(const BudgetResource&) = delete;
+
+	// called with the bytes of a request over the limit (OverBudget::callback)
+	void onOverBudget(std::function<bool(std::size_t bytes)> f) {
+		callback = std::move(f);
+	}
+
+	// may be lowered below what is in use, that only stops new requests
+	void setLimit(std::size_t limit) {
+		maxBytes.store(limit, std::memory_order_relaxed);
+	}
+
+	std::size_t limit() const {
+		return maxBytes.load(std::memory_order_relaxed);
+	}
+
+	// charged to this budget, without what was given out over it
+	std::size_t used() const {
+		return usedBytes.load(std::memory_order_relaxed);
+	}
+
+	std::size_t peak() const {
+		return peakBytes.load(std::memory_order_relaxed);
+	}
+
+	// requests over the limit: failed and given out from upstream anyway
+	std::size_t rejected() const {
+		return numRejected.load(std::memory_order_relaxed);
+	}
+
+	std::size_t fallbackCount() const {
+		return numFallbacks.load(std::memory_order_relaxed);
+	}
+
+	std::pmr::memory_resource* upstream_resource() const {
+		return upstream;
+	}
+
+	// what passed through and was not given back yet, over the limit or not
+	ResourceStats stats() const override {
+		ResourceStats s;
+		s.bytesInUse = s.bytesReserved = used() + fallbackBytes.load(std::memory_order_relaxed);
+		s.chunks = usedBlocks.load(std::memory_order_relaxed)
+			+ liveFallbacks.load(std::memory_order_relaxed);
+		return s;
+	}
+
+private:
+	bool charge(std::size_t bytes) {
+		std::size_t cur = usedBytes.load(std::memory_order_relaxed);
+		do {
+			if (cur + bytes > maxBytes.load(std::memory_order_relaxed) || cur + bytes < cur) {
+				return false;
+			}
+		} while (!usedBytes.compare_exchange_weak(cur, cur + bytes, std::memory_order_relaxed));
+		std::size_t peak = peakBytes.load(std::memory_order_relaxed);
+		while (cur + bytes > peak
+			&& !peakBytes.compare_exchange_weak(peak, cur + bytes, std::memory_order_relaxed)) {
+		}
+		return true;
+	}
+
+	void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+		while (!charge(bytes)) {
+			numRejected.fetch_add(1, std::memory_order_relaxed);
+			if (policy == OverBudget::fallback) {
+				void* p = upstream->allocate(bytes, alignment);
+				try {
+					std::lock_guard<std::mutex> lg{ m };
+					fallbacks.insert(p);
+				}
+				catch (...) {
+					upstream->deallocate(p, bytes, alignment);
+					throw;
+				}
+				numFallbacks.fetch_add(1, std::memory_order_relaxed);
+				liveFallbacks.fetch_add(1, std::memory_order_relaxed);
+				fallbackBytes.fetch_add(bytes, std::memory_order_relaxed);
+				return p;
+			}
+			if (policy == OverBudget::fail || !callback || !callback(bytes)) {
+				throw std::bad_alloc{};
+			}
+		}
+		try {
+			void* p = upstream->allocate(bytes, alignment);
+			usedBlocks.fetch_add(1, std::memory_order_relaxed);
+			return p;
+		}
+		catch (...) {
+			usedBytes.fetch_sub(bytes, std::memory_order_relaxed);
+			throw;
+		}
+	}
+
+	void do_deallocate(void* ptr, std::size_t bytes, std::size_t alignment)
+		override {
+		// only look when there are blocks given out over the limit
+		if (liveFallbacks.load(std::memory_order_relaxed) > 0) {
+			std::unique_lock<std::mutex> lg{ m };
+			if (fallbacks.erase(ptr) > 0) {
+				lg.unlock();
+				liveFallbacks.fetch_sub(1, std::memory_order_relaxed);
+				fallbackBytes.fetch_sub(bytes, std::memory_order_relaxed);
+				upstream->deallocate(ptr, bytes, alignment);
+				return;
+			}
+		}
+		upstream->deallocate(ptr, bytes, alignment);
+		usedBytes.fetch_sub(bytes, std::memory_order_relaxed);
+		usedBlocks.fetch_sub(1, std::memory_order_relaxed);
+	}
+
+	bool do_is_equal(const std::pmr::memory_resource& other) const noexcept
+		override {
+		return this == &other;
+	}
+};
+
+#endif // BUDGET_HPP
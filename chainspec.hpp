@@ -0,0 +1,396 @@
+#ifndef CHAINSPEC_HPP
+#define CHAINSPEC_HPP
+
+#include <memory_resource>
+#include <memory>      // for std::unique_ptr
+#include <vector>
+#include <string>
+#include <string_view>
+#include <iostream>    // for std::cout, where trackers print by default
+#include <map>
+#include <stdexcept>   // for std::invalid_argument
+#include <initializer_list>
+#include <cctype>      // for std::isspace(), std::isalnum() and std::isdigit()
+#include <cstdint>     // for SIZE_MAX
+#include "arena.hpp"
+#include "pool.hpp"
+#include "adaptivepool.hpp"
+#include "tracker.hpp"
+#include "pageresource.hpp"
+#include "budget.hpp"
+#include "threaddefault.hpp"
+
+// A chain of resources built at runtime from a spec like
+//
+//   sync_pool(max_blocks=64)->tracker("  syncpool")->monotonic(10000)->hugepage
+//
+// Layers are listed from the top (what containers use) down, "->" reads
+// "takes its memory from". The last entry may name where the bottom layer
+// gets its memory, otherwise that is the default resource of the thread
+// (see threaddefault.hpp).
+//
+// Layers:
+//   tracker("prefix")                     Tracker
+//   monotonic(initial)                    std::pmr::monotonic_buffer_resource
+//   sync_pool(max_blocks=, largest=)      std::pmr::synchronized_pool_resource
+//   unsync_pool(max_blocks=, largest=)    std::pmr::unsynchronized_pool_resource
+//   pool(max_blocks=, largest=)           Pool
+//   adaptive_pool(max_blocks=, largest=, max_exact=)
+//                                         AdaptivePool
+//   arena(initial, factor=, max_chunk=, round=, reserve=)
+//                                         Arena
+//   budget(limit, over=fail|fallback)     BudgetResource
+// Sources:
+//   default, new_delete, null, pages, hugepage (PageResource)
+//
+// Numbers take a k, M or G suffix (powers of 1024). Bad specs throw
+// std::invalid_argument telling where. Trackers print to the passed
+// stream.
+class ResourceChain
+{
+private:
+	std::string text;
+	std::vector<std::string> names;    // layer names, top first
+	std::pmr::memory_resource* base = nullptr;
+	std::ostream* log;                 // for the trackers
+	std::vector<std::unique_ptr<std::pmr::memory_resource>> owned;  // bottom first
+
+	struct Args {
+		std::vector<std::string> positional;
+		std::map<std::string, std::string> named;
+	};
+	struct Layer {
+		std::string name;
+		Args args;
+		std::size_t pos;
+	};
+
+public:
+	explicit ResourceChain(std::string_view spec, std::ostream& os = std::cout)
+		: text{ spec }, log{ &os } {
+		std::vector<Layer> layers = parse(spec);
+
+		// the last entry may be the source:
+		if (!layers.empty() && layers.back().args.positional.empty()
+			&& layers.back().args.named.empty()
+			&& makeSource(layers.back().name)) {
+			layers.pop_back();
+		}
+		if (base == nullptr) {
+			base = get_thread_default();
+		}
+		if (layers.empty()) {
+			throw std::invalid_argument{ "chain spec: no layers in '" + text + "'" };
+		}
+		try {
+			for (auto it = layers.rbegin(); it != layers.rend(); ++it) {
+				owned.push_back(makeLayer(*it, top()));
+			}
+		}
+		catch (...) {
+			clear();
+			throw;
+		}
+		for (const Layer& l : layers) {
+			names.push_back(l.name);
+		}
+	}
+
+	ResourceChain(const ResourceChain&) = delete;
+	ResourceChain& operator=(const ResourceChain&) = delete;
+
+	~ResourceChain() {
+		clear();
+	}
+
+	// what containers should use
+	std::pmr::memory_resource* top() const {
+		return owned.empty() ? base : owned.back().get();
+	}
+
+	const std::string& spec() const {
+		return text;
+	}
+
+	const std::vector<std::string>& layerNames() const {
+		return names;
+	}
+
+private:
+	void clear() noexcept {
+		while (!owned.empty()) {   // the top goes first
+			owned.pop_back();
+		}
+	}
+
+	[[noreturn]] void fail(const std::string& what, std::size_t pos) const {
+		throw std::invalid_argument{ "chain spec: " + what + " at "
+			+ std::to_string(pos) + " in '" + text + "'" };
+	}
+
+	std::vector<Layer> parse(std::string_view s) const {
+		std::vector<Layer> layers;
+		std::size_t i = 0;
+		auto skipSpace = [&] {
+			while (i < s.size() && std::isspace(static_cast<unsigned char>(s[i]))) {
+				++i;
+			}
+		};
+		auto word = [&] {
+			std::size_t start = i;
+			while (i < s.size() && (std::isalnum(static_cast<unsigned char>(s[i]))
+				|| s[i] == '_' || s[i] == '.')) {
+				++i;
+			}
+			return std::string{ s.substr(start, i - start) };
+		};
+
+		for (;;) {
+			skipSpace();
+			Layer l;
+			l.pos = i;
+			l.name = word();
+			if (l.name.empty()) {
+				fail("layer name expected", i);
+			}
+			skipSpace();
+			if (i < s.size() && s[i] == '(') {
+				++i;
+				skipSpace();
+				while (i < s.size() && s[i] != ')') {
+					std::string key, value;
+					if (s[i] == '"') {
+						std::size_t close = s.find('"', i + 1);
+						if (close == std::string_view::npos) {
+							fail("unterminated string", i);
+						}
+						value = std::string{ s.substr(i + 1, close - i - 1) };
+						i = close + 1;
+					}
+					else {
+						value = word();
+						skipSpace();
+						if (i < s.size() && s[i] == '=') {
+							++i;
+							skipSpace();
+							key = value;
+							if (i < s.size() && s[i] == '"') {
+								std::size_t close = s.find('"', i + 1);
+								if (close == std::string_view::npos) {
+									fail("unterminated string", i);
+								}
+								value = std::string{ s.substr(i + 1, close - i - 1) };
+								i = close + 1;
+							}
+							else {
+								value = word();
+							}
+						}
+						if (value.empty()) {
+							fail("argument expected", i);
+						}
+					}
+					if (key.empty()) {
+						l.args.positional.push_back(value);
+					}
+					else {
+						l.args.named[key] = value;
+					}
+					skipSpace();
+					if (i < s.size() && s[i] == ',') {
+						++i;
+						skipSpace();
+					}
+					else if (i < s.size() && s[i] != ')') {
+						fail("',' or ')' expected", i);
+					}
+				}
+				if (i >= s.size()) {
+					fail("')' expected", i);
+				}
+				++i;
+				skipSpace();
+			}
+			layers.push_back(std::move(l));
+			if (i >= s.size()) {
+				break;
+			}
+			if (s.compare(i, 2, "->") != 0) {
+				fail("'->' expected", i);
+			}
+			i += 2;
+		}
+		return layers;
+	}
+
+	std::size_t number(const std::string& v, const Layer& l) const {
+		std::size_t used = 0;
+		unsigned long long n = 0;
+		// stoull() takes a sign and wraps "-1" around to the largest value
+		if (v.empty() || !std::isdigit(static_cast<unsigned char>(v[0]))) {
+			fail("number expected instead of '" + v + "'", l.pos);
+		}
+		try {
+			n = std::stoull(v, &used);
+		}
+		catch (const std::exception&) {
+			fail("number expected instead of '" + v + "'", l.pos);
+		}
+		if (n > SIZE_MAX) {
+			fail("number too large '" + v + "'", l.pos);
+		}
+		if (used + 1 == v.size()) {
+			unsigned shift = 0;
+			switch (v[used]) {
+			case 'k': case 'K': shift = 10; break;
+			case 'M': shift = 20; break;
+			case 'G': shift = 30; break;
+			default: fail("bad number '" + v + "'", l.pos);
+			}
+			if (n > (SIZE_MAX >> shift)) {
+				fail("number too large '" + v + "'", l.pos);
+			}
+			n <<= shift;
+		}
+		else if (used != v.size()) {
+			fail("bad number '" + v + "'", l.pos);
+		}
+		return static_cast<std::size_t>(n);
+	}
+
+	// value of a named argument (or the first positional one if allowed)
+	std::size_t numberArg(const Layer& l, const char* key, std::size_t def,
+		bool positional = false) const {
+		auto it = l.args.named.find(key);
+		if (it != l.args.named.end()) {
+			return number(it->second, l);
+		}
+		if (positional && !l.args.positional.empty()) {
+			return number(l.args.positional.front(), l);
+		}
+		return def;
+	}
+
+	void checkArgs(const Layer& l, std::initializer_list<const char*> keys,
+		std::size_t maxPositional) const {
+		if (l.args.positional.size() > maxPositional) {
+			fail("too many arguments for " + l.name, l.pos);
+		}
+		for (const auto& [key, value] : l.args.named) {
+			bool known = false;
+			for (const char* k : keys) {
+				known = known || key == k;
+			}
+			if (!known) {
+				fail("unknown argument '" + key + "' for " + l.name, l.pos);
+			}
+		}
+	}
+
+	bool makeSource(const std::string& name) {
+		if (name == "default") {
+			base = get_thread_default();
+		}
+		else if (name == "new_delete") {
+			base = std::pmr::new_delete_resource();
+		}
+		else if (name == "null") {
+			base = std::pmr::null_memory_resource();
+		}
+		else if (name == "pages" || name == "hugepage") {
+			owned.push_back(std::make_unique<PageResource>(name == "hugepage"));
+			base = owned.back().get();
+		}
+		else {
+			return false;
+		}
+		return true;
+	}
+
+	std::unique_ptr<std::pmr::memory_resource> makeLayer(const Layer& l,
+		std::pmr::memory_resource* us) const {
+		if (l.name == "tracker") {
+			checkArgs(l, {}, 1);
+			std::string prefix = l.args.positional.empty() ? "" : l.args.positional.front();
+			return std::make_unique<Tracker>(prefix, us, *log);
+		}
+		if (l.name == "monotonic") {
+			checkArgs(l, { "initial" }, 1);
+			return std::make_unique<std::pmr::monotonic_buffer_resource>(
+				numberArg(l, "initial", 1024, true), us);
+		}
+		if (l.name == "sync_pool" || l.name == "unsync_pool" || l.name == "pool") {
+			checkArgs(l, { "max_blocks", "largest" }, 0);
+			std::pmr::pool_options opts;
+			opts.max_blocks_per_chunk = numberArg(l, "max_blocks", 0);
+			opts.largest_required_pool_block = numberArg(l, "largest", 0);
+			if (l.name == "sync_pool") {
+				return std::make_unique<std::pmr::synchronized_pool_resource>(opts, us);
+			}
+			if (l.name == "unsync_pool") {
+				return std::make_unique<std::pmr::unsynchronized_pool_resource>(opts, us);
+			}
+			return std::make_unique<Pool>(opts, us);
+		}
+		if (l.name == "adaptive_pool") {
+			checkArgs(l, { "max_blocks", "largest", "max_exact" }, 0);
+			AdaptivePool::Options opts;
+			opts.maxBlocks = numberArg(l, "max_blocks", 0);
+			opts.largest = numberArg(l, "largest", 0);
+			opts.maxExact = numberArg(l, "max_exact", opts.maxExact);
+			auto pool = std::make_unique<AdaptivePool>(opts, us);
+			// the pool clamps it to its sizes, one per 8 bytes up to largest
+			if (pool->options().maxExact != opts.maxExact) {
+				fail("max_exact must be at most " + std::to_string(pool->options().maxExact),
+					l.pos);
+			}
+			return pool;
+		}
+		if (l.name == "budget") {
+			checkArgs(l, { "limit", "over" }, 1);
+			if (l.args.positional.empty() && l.args.named.count("limit") == 0) {
+				fail("budget needs a limit", l.pos);
+			}
+			auto over = l.args.named.find("over");
+			BudgetResource::OverBudget policy = BudgetResource::OverBudget::fail;
+			if (over != l.args.named.end()) {
+				if (over->second == "fallback") {
+					policy = BudgetResource::OverBudget::fallback;
+				}
+				else if (over->second != "fail") {
+					fail("over must be fail or fallback", l.pos);
+				}
+			}
+			return std::make_unique<BudgetResource>(numberArg(l, "limit", 0, true), policy, us);
+		}
+		if (l.name == "arena") {
+			checkArgs(l, { "initial", "factor", "max_chunk", "round", "reserve" }, 1);
+			Arena::Options opts;
+			opts.initialSize = numberArg(l, "initial", opts.initialSize, true);
+			auto f = l.args.named.find("factor");
+			if (f != l.args.named.end()) {
+				std::size_t used = 0;
+				try {
+					opts.growthFactor = std::stod(f->second, &used);
+				}
+				catch (const std::exception&) {
+					fail("bad factor '" + f->second + "'", l.pos);
+				}
+				// as the arena checks it, NaN included
+				if (used != f->second.size() || !(opts.growthFactor >= 1)) {
+					fail("factor must be a number of at least 1, not '" + f->second + "'", l.pos);
+				}
+			}
+			opts.maxChunkSize = numberArg(l, "max_chunk", 0);
+			opts.roundTo = numberArg(l, "round", 0);
+			if ((opts.roundTo & (opts.roundTo - 1)) != 0) {
+				fail("round must be a power of two", l.pos);
+			}
+			opts.reserve = numberArg(l, "reserve", 0);
+			return std::make_unique<Arena>(opts, us);
+		}
+		fail("unknown layer '" + l.name + "'", l.pos);
+	}
+};
+
+#endif // CHAINSPEC_HPP
@@ -0,0 +1,171 @@
+#ifndef COMPOSE_HPP
+#define COMPOSE_HPP
+
+#include <memory_resource>
+#include <cstddef>
+#include "arena.hpp"
+#include "pool.hpp"
+#include "tracker.hpp"
+#include "introspect.hpp"
+#include "threaddefault.hpp"
+
+// Resource chains put together at compile time. Instead of
+//
+//   std::pmr::monotonic_buffer_resource keep{ 10000 };
+//   std::pmr::unsynchronized_pool_resource pool{ &keep };
+//
+// where every layer calls the next one through the vtable, write
+//
+//   compose::chain<compose::pool<>, compose::monotonic<10000>> res;
+//
+// The layers are single-threaded: compose::pool is the unsynchronized
+// Pool, so a chain can't replace one with a synchronized_pool_resource
+// that threads share.
+// Layers are listed from the top (what containers see) down to the bottom
+// (which takes from the resource passed to the chain, the default resource
+// if none). Each layer knows the type of the one below it and calls it
+// directly, only the chain itself is used through memory_resource.
+namespace compose {
+
+// layer specs: resource<Up> is the resource on top of Up, make() builds it
+template<std::size_t InitialSize = 1024>
+struct monotonic {
+	template<typename Up>
+	using resource = BasicArena<Up>;
+
+	template<typename Up>
+	static resource<Up> make(Up* us) {
+		return resource<Up>{ InitialSize, us };
+	}
+};
+
+template<std::size_t LargestBlock = 0, std::size_t MaxBlocksPerChunk = 0>
+struct pool {
+	template<typename Up>
+	using resource = BasicPool<Up>;
+
+	template<typename Up>
+	static resource<Up> make(Up* us) {
+		return resource<Up>{ std::pmr::pool_options{ MaxBlocksPerChunk, LargestBlock }, us };
+	}
+};
+
+inline constexpr char noPrefix[] = "";
+
+// the prefix has to be a char array with static storage, e.g.
+//   static constexpr char keep[] = "keeppool:";
+template<const char* Prefix = noPrefix>
+struct tracker {
+	template<typename Up>
+	using resource = BasicTracker<Up>;
+
+	template<typename Up>
+	static resource<Up> make(Up* us) {
+		return resource<Up>{ Prefix, us };
+	}
+};
+
+namespace detail {
+	// the layers of a chain, the one below is constructed first and
+	// destroyed last
+	template<typename... Layers>
+	struct stack;
+
+	template<>
+	struct stack<> {
+		using top_type = std::pmr::memory_resource;
+		std::pmr::memory_resource* res;
+
+		explicit stack(std::pmr::memory_resource* us) : res{ us } {
+		}
+		top_type* top() {
+			return res;
+		}
+	};
+
+	template<typename Layer, typename... Below>
+	struct stack<Layer, Below...> {
+		using below_type = stack<Below...>;
+		using top_type = typename Layer::template resource<typename below_type::top_type>;
+
+		below_type below;
+		top_type layer;
+
+		explicit stack(std::pmr::memory_resource* us)
+			: below{ us }, layer{ Layer::make(below.top()) } {
+		}
+		top_type* top() {
+			return &layer;
+		}
+	};
+
+	template<std::size_t I, typename Stack>
+	auto& get(Stack& s) {
+		if constexpr (I == 0) {
+			return s.layer;
+		}
+		else {
+			return get<I - 1>(s.below);
+		}
+	}
+}
+
+template<typename... Layers>
+class chain final : public introspectable_resource
+{
+	static_assert(sizeof...(Layers) > 0, "a chain needs at least one layer");
+
+private:
+	detail::stack<Layers...> layers;
+
+public:
+	explicit chain(std::pmr::memory_resource* us = get_thread_default())
+		: layers{ us } {
+	}
+
+	chain(const chain&) = delete;
+	chain& operator=(const chain&) = delete;
+
+	// the I-th layer from the top, e.g. to rewind an arena in the chain
+	template<std::size_t I>
+	auto& layer() {
+		return detail::get<I>(layers);
+	}
+
+	// hides memory_resource::allocate() for callers that know the type
+	[[nodiscard]]
+	void* allocate(std::size_t bytes,
+		std::size_t alignment = alignof(std::max_align_t)) {
+		return layers.layer.allocate(bytes, alignment);
+	}
+
+	void deallocate(void* ptr, std::size_t bytes,
+		std::size_t alignment = alignof(std::max_align_t)) {
+		layers.layer.deallocate(ptr, bytes, alignment);
+	}
+
+	// those of the top layer, layer<I>() has the others
+	ResourceStats stats() const override {
+		const introspectable_resource* i = introspect(&layers.layer);
+		return i ? i->stats() : ResourceStats{};
+	}
+
+private:
+	void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+		return allocate(bytes, alignment);
+	}
+
+	void do_deallocate(void* ptr, std::size_t bytes, std::size_t alignment)
+		override {
+		deallocate(ptr, bytes, alignment);
+	}
+
+	bool do_is_equal(const std::pmr::memory_resource& other) const noexcept
+		override {
+		return this == &other;
+	}
+};
+
+} // namespace compose
+
+#endif // COMPOSE_HPP
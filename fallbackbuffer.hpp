@@ -0,0 +1,157 @@
+#ifndef FALLBACKBUFFER_HPP
+#define FALLBACKBUFFER_HPP
+
+#include <memory_resource>
+#include <memory>    // for std::align()
+#include <cstddef>   // for std::byte
+#include <cstdio>    // for printf()
+#include "introspect.hpp"
+#include "threaddefault.hpp"
+
+// Survives the buffer: a FallbackBuffer writes into it how big its buffer
+// should have been, so the next one can be sized right.
+struct BufferSizeHint {
+	std::size_t size = 0;
+};
+
+// Like a monotonic_buffer_resource on a fixed buffer with
+// null_memory_resource() as upstream, but instead of throwing bad_alloc
+// when the buffer is full, it hands out memory from a fallback resource
+// and records that it had to.
+class FallbackBuffer final : public introspectable_resource
+{
+public:
+	// the allocation that first did not fit into the buffer
+	struct Overflow {
+		std::size_t call = 0;       // number of the allocate() call, from 1
+		std::size_t bytes = 0;
+		std::size_t alignment = 0;
+		std::size_t used = 0;       // buffer bytes used at that time
+	};
+
+private:
+	std::byte* begin;
+	std::byte* cur;
+	std::byte* end;
+	std::pmr::memory_resource* upstream;
+	BufferSizeHint* hint = nullptr;
+	const char* name = "";
+	bool doTrace = false;
+
+	std::size_t numCalls = 0;        // allocate() calls so far
+	std::size_t numOverflows = 0;    // how many of them went upstream
+	std::size_t overflowBytes = 0;   // and how many bytes they asked for
+	std::size_t liveBytes = 0;       // of them not given back yet
+	std::size_t liveBlocks = 0;
+	Overflow first{};
+
+public:
+	FallbackBuffer(void* buffer, std::size_t size,
+		std::pmr::memory_resource* us = get_thread_default())
+		: begin{ static_cast<std::byte*>(buffer) }, cur{ begin },
+		  end{ begin + size }, upstream{ us } {
+	}
+
+	// reports the size the buffer should have had to hint when destroyed
+	FallbackBuffer(void* buffer, std::size_t size, BufferSizeHint& h,
+		std::pmr::memory_resource* us = get_thread_default())
+		: FallbackBuffer{ buffer, size, us } {
+		hint = &h;
+	}
+
+	FallbackBuffer(const FallbackBuffer&) = delete;
+	FallbackBuffer& operator=(const FallbackBuffer&) = delete;
+
+	~FallbackBuffer() {
+		if (hint != nullptr && recommendedSize() > hint->size) {
+			hint->size = recommendedSize();
+		}
+	}
+
+	void trace(bool b, const char* n = "") {  // print every overflow
+		doTrace = b;
+		name = n;
+	}
+
+	std::size_t overflows() const {
+		return numOverflows;
+	}
+
+	std::size_t overflowedBytes() const {
+		return overflowBytes;
+	}
+
+	// only meaningful if overflows() > 0
+	const Overflow& firstOverflow() const {
+		return first;
+	}
+
+	std::size_t bufferUsed() const {
+		return static_cast<std::size_t>(cur - begin);
+	}
+
+	// a buffer this big would have served everything so far
+	std::size_t recommendedSize() const {
+		return bufferUsed() + overflowBytes;
+	}
+
+	// the buffer is one chunk, every overflow block still alive another
+	ResourceStats stats() const override {
+		ResourceStats s;
+		s.bytesInUse = bufferUsed() + liveBytes;
+		s.bytesReserved = static_cast<std::size_t>(end - begin) + liveBytes;
+		s.chunks = 1 + liveBlocks;
+		return s;
+	}
+
+	void status() const {               // print current state
+		printf("%s%zu of %zu buffer bytes used, %zu overflows for %zu bytes\n",
+			name, bufferUsed(), static_cast<std::size_t>(end - begin),
+			numOverflows, overflowBytes);
+	}
+
+private:
+	bool inBuffer(const void* p) const {
+		return p >= begin && p < end;
+	}
+
+	void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+		++numCalls;
+		void* p = cur;
+		std::size_t space = static_cast<std::size_t>(end - cur);
+		if (std::align(alignment, bytes, p, space)) {
+			cur = static_cast<std::byte*>(p) + bytes;
+			return p;
+		}
+
+		if (numOverflows++ == 0) {
+			first = Overflow{ numCalls, bytes, alignment, bufferUsed() };
+		}
+		overflowBytes += bytes;
+		if (doTrace) {
+			printf("%soverflow #%zu at call %zu (%zu bytes, %zu-byte aligned)\n",
+				name, numOverflows, numCalls, bytes, alignment);
+		}
+		void* ret = upstream->allocate(bytes, alignment);
+		liveBytes += bytes;
+		++liveBlocks;
+		return ret;
+	}
+
+	// buffer memory is only freed with the buffer, overflow memory at once
+	void do_deallocate(void* ptr, std::size_t bytes, std::size_t alignment)
+		override {
+		if (!inBuffer(ptr)) {
+			upstream->deallocate(ptr, bytes, alignment);
+			liveBytes -= bytes;
+			--liveBlocks;
+		}
+	}
+
+	bool do_is_equal(const std::pmr::memory_resource& other) const noexcept
+		override {
+		return this == &other;
+	}
+};
+
+#endif // FALLBACKBUFFER_HPP
@@ -0,0 +1,56 @@
+#ifndef INTROSPECT_HPP
+#define INTROSPECT_HPP
+
+#include <memory_resource>
+#include <vector>
+#include <cstddef>
+#include <cstdio>    // for printf()
+
+// What a resource holds and how much of it is really used. Standard
+// resources tell nothing beyond their options(), the in-tree ones derive
+// from introspectable_resource and report this.
+struct ResourceStats {
+	struct SizeClass {
+		std::size_t blockSize = 0;
+		std::size_t blocks = 0;      // in chunks taken for this class
+		std::size_t inUse = 0;       // of them handed out
+	};
+	std::size_t bytesInUse = 0;      // asked for and not given back
+	std::size_t bytesReserved = 0;   // held to serve that: chunks from
+	                                 // upstream and own buffers
+	std::size_t chunks = 0;          // pieces of memory held
+	std::size_t tailWaste = 0;       // reserved bytes lost to rounding up
+	                                 // blocks and chunk ends left behind
+	std::size_t bytesTrimmed = 0;    // of those reserved, given back to the
+	                                 // OS by trim() (pools only)
+	std::vector<SizeClass> sizeClasses;   // pools only
+};
+
+// a memory_resource that can tell what it holds, e.g. for dashboards
+class introspectable_resource : public std::pmr::memory_resource
+{
+public:
+	virtual ResourceStats stats() const = 0;
+};
+
+// the stats interface of r, or nullptr for resources that have none
+inline const introspectable_resource* introspect(const std::pmr::memory_resource* r) {
+	return dynamic_cast<const introspectable_resource*>(r);
+}
+
+inline void printStats(const ResourceStats& s, const char* name = "") {
+	printf("%s%zu bytes in use of %zu reserved in %zu chunks, %zu bytes tail waste",
+		name, s.bytesInUse, s.bytesReserved, s.chunks, s.tailWaste);
+	if (s.bytesTrimmed > 0) {
+		printf(", %zu bytes trimmed", s.bytesTrimmed);
+	}
+	printf("\n");
+	for (const auto& c : s.sizeClasses) {
+		if (c.blocks > 0) {
+			printf("%s  %6zu byte blocks: %zu of %zu in use\n",
+				name, c.blockSize, c.inUse, c.blocks);
+		}
+	}
+}
+
+#endif // INTROSPECT_HPP
@@ -0,0 +1,66 @@
+#ifndef LOCALITY_HPP
+#define LOCALITY_HPP
+
+#include <iostream>
+#include <iomanip>
+#include <array>
+#include <cstddef>
+#include <cstdint>   // for std::uintptr_t
+
+// How far apart consecutive elements of a container lie in memory, in the
+// order a traversal visits them. Distances go into power-of-two buckets:
+// bucket k counts distances below 2^k bytes (and at least 2^(k-1)), the
+// last one everything from 2^(buckets-2) up. Mostly small distances mean a
+// traversal walks through few cache lines and pages.
+struct DistanceHistogram {
+	static constexpr std::size_t buckets = 32;
+	std::array<std::size_t, buckets> count{};
+	std::size_t total = 0;
+
+	void add(const void* from, const void* to) {
+		auto a = reinterpret_cast<std::uintptr_t>(from);
+		auto b = reinterpret_cast<std::uintptr_t>(to);
+		std::uintptr_t d = a < b ? b - a : a - b;
+		std::size_t k = 0;
+		while (d > 0 && k < buckets - 1) {
+			d >>= 1;
+			++k;
+		}
+		++count[k];
+		++total;
+	}
+
+	// share of the distances below the given number of bytes
+	double shareBelow(std::size_t bytes) const {
+		std::size_t n = 0;
+		for (std::size_t k = 0; k < buckets && (std::size_t{ 1 } << k) <= bytes; ++k) {
+			n += count[k];
+		}
+		return total ? double(n) / total : 0;
+	}
+
+	void print(std::ostream& os = std::cout) const {
+		for (std::size_t k = 0; k < buckets; ++k) {
+			if (count[k] == 0) {
+				continue;
+			}
+			os << "  < " << std::setw(11) << (std::size_t{ 1 } << k) << " Bytes: "
+				<< count[k] << '\n';
+		}
+	}
+};
+
+template<typename Coll>
+DistanceHistogram distanceHistogram(const Coll& coll) {
+	DistanceHistogram h;
+	const void* last = nullptr;
+	for (const auto& elem : coll) {
+		if (last != nullptr) {
+			h.add(last, &elem);
+		}
+		last = &elem;
+	}
+	return h;
+}
+
+#endif // LOCALITY_HPP
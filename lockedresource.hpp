@@ -0,0 +1,53 @@
+#ifndef LOCKEDRESOURCE_HPP
+#define LOCKEDRESOURCE_HPP
+
+#include <mutex>
+#include <memory_resource>
+#include "introspect.hpp"
+#include "threaddefault.hpp"
+
+// Makes an unsynchronized resource (Pool, Arena, ...) usable from several
+// threads by guarding it with one std::mutex, the implementation the
+// comment above exampleSyncPoolBadImpl() warns about. The benchmarks use
+// it to measure what that costs.
+class LockedResource final : public introspectable_resource
+{
+private:
+	mutable std::mutex m;
+	std::pmr::memory_resource* upstream;
+
+public:
+	explicit LockedResource(std::pmr::memory_resource* us = get_thread_default())
+		: upstream{ us } {
+	}
+
+	std::pmr::memory_resource* upstream_resource() const {
+		return upstream;
+	}
+
+	// those of the guarded resource, read under the lock
+	ResourceStats stats() const override {
+		std::lock_guard<std::mutex> lg{ m };
+		const introspectable_resource* i = introspect(upstream);
+		return i ? i->stats() : ResourceStats{};
+	}
+
+private:
+	void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+		std::lock_guard<std::mutex> lg{ m };
+		return upstream->allocate(bytes, alignment);
+	}
+
+	void do_deallocate(void* ptr, std::size_t bytes, std::size_t alignment)
+		override {
+		std::lock_guard<std::mutex> lg{ m };
+		upstream->deallocate(ptr, bytes, alignment);
+	}
+
+	bool do_is_equal(const std::pmr::memory_resource& other) const noexcept
+		override {
+		return this == &other;
+	}
+};
+
+#endif // LOCKEDRESOURCE_HPP
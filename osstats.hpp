@@ -0,0 +1,96 @@
+#ifndef OSSTATS_HPP
+#define OSSTATS_HPP
+
+#include <cstdio>    // for printf() and fopen()
+#include <cstring>   // for strncmp()
+
+#ifdef __linux__
+#include <sys/resource.h>
+#include <unistd.h>  // for sysconf()
+#endif
+
+// What the OS sees of our memory, as opposed to what TrackNew counts:
+// page faults of the process, all its threads (getrusage()), and its
+// resident set (/proc/self/statm), optionally with the proportional set
+// size of /proc/self/smaps_rollup, which is slower to read. Values that
+// can't be had (not Linux, no smaps_rollup before 4.14) stay 0.
+//
+// Sizes are signed so the difference of two snapshots is one as well.
+struct OsStats {
+	long minorFaults = 0;     // served without I/O, e.g. first touch of a page
+	long majorFaults = 0;     // needed I/O
+	long long rss = 0;        // bytes resident
+	long long pss = 0;        // resident bytes, shared pages split among users
+
+	static OsStats now(bool withPss = false) {
+		OsStats s;
+#ifdef __linux__
+		rusage ru;
+		if (getrusage(RUSAGE_SELF, &ru) == 0) {
+			s.minorFaults = ru.ru_minflt;
+			s.majorFaults = ru.ru_majflt;
+		}
+		long long pageSize = sysconf(_SC_PAGESIZE);
+		if (std::FILE* f = std::fopen("/proc/self/statm", "r")) {
+			long long size = 0, resident = 0;
+			if (std::fscanf(f, "%lld %lld", &size, &resident) == 2) {
+				s.rss = resident * pageSize;
+			}
+			std::fclose(f);
+		}
+		if (withPss) {
+			if (std::FILE* f = std::fopen("/proc/self/smaps_rollup", "r")) {
+				char line[256];
+				while (std::fgets(line, sizeof(line), f)) {
+					long long kb = 0;
+					if (std::strncmp(line, "Pss:", 4) == 0
+						&& std::sscanf(line + 4, "%lld", &kb) == 1) {
+						s.pss = kb * 1024;
+						break;
+					}
+				}
+				std::fclose(f);
+			}
+		}
+#else
+		(void)withPss;
+#endif
+		return s;
+	}
+
+	OsStats operator-(const OsStats& other) const {
+		OsStats d;
+		d.minorFaults = minorFaults - other.minorFaults;
+		d.majorFaults = majorFaults - other.majorFaults;
+		d.rss = rss - other.rss;
+		d.pss = pss - other.pss;
+		return d;
+	}
+
+	void status() const {       // print like TrackNew::status()
+		printf("%ld minor/%ld major page faults, rss %lld bytes",
+			minorFaults, majorFaults, rss);
+		if (pss != 0) {
+			printf(", pss %lld bytes", pss);
+		}
+		printf("\n");
+	}
+
+	class Scope;
+};
+
+// what changed over a block of code
+class OsStats::Scope {
+private:
+	bool withPss;
+	OsStats start;
+public:
+	explicit Scope(bool pss = false)
+		: withPss{ pss }, start{ now(pss) } {
+	}
+	OsStats delta() const {
+		return now(withPss) - start;
+	}
+};
+
+#endif // OSSTATS_HPP
@@ -0,0 +1,121 @@
+#ifndef PAGERESOURCE_HPP
+#define PAGERESOURCE_HPP
+
+#include <memory_resource>
+#include <atomic>
+#include <new>       // for std::bad_alloc and std::align_val_t
+#include <cstddef>
+#include <cstdint>   // for std::uintptr_t
+#include "introspect.hpp"
+#ifdef __linux__
+#include <sys/mman.h>  // for mmap(), munmap() and madvise()
+#endif
+
+// Takes memory straight from the OS in whole pages, as the bottom of a
+// chain of resources. With hugePages set, blocks are rounded to 2 MiB,
+// aligned to it and marked for transparent huge pages, which saves TLB
+// misses on big arenas and pools. Where there is no mmap() this falls
+// back on aligned ::operator new.
+class PageResource final : public introspectable_resource
+{
+public:
+	static constexpr std::size_t pageSize = 4096;
+	static constexpr std::size_t hugePageSize = 2 * 1024 * 1024;
+
+private:
+	bool huge;
+	// atomic, the OS calls need no lock, so neither should the counting
+	std::atomic<std::size_t> liveBytes{ 0 };    // asked for
+	std::atomic<std::size_t> liveMapped{ 0 };   // rounded to pages
+	std::atomic<std::size_t> liveBlocks{ 0 };
+
+public:
+	explicit PageResource(bool hugePages = false)
+		: huge{ hugePages } {
+	}
+
+	bool hugePages() const {
+		return huge;
+	}
+
+	// bytes a request really takes
+	std::size_t roundedSize(std::size_t bytes) const {
+		std::size_t gran = huge ? hugePageSize : pageSize;
+		return (bytes + gran - 1) & ~(gran - 1);
+	}
+
+	// every mapping is a chunk, its rounding the tail waste
+	ResourceStats stats() const override {
+		ResourceStats s;
+		s.bytesInUse = liveBytes.load(std::memory_order_relaxed);
+		s.bytesReserved = liveMapped.load(std::memory_order_relaxed);
+		s.chunks = liveBlocks.load(std::memory_order_relaxed);
+		// read while other threads allocate, the two may not match up
+		s.tailWaste = s.bytesReserved > s.bytesInUse ? s.bytesReserved - s.bytesInUse : 0;
+		return s;
+	}
+
+private:
+	void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+		void* p = map(bytes, alignment);
+		liveBytes.fetch_add(bytes, std::memory_order_relaxed);
+		liveMapped.fetch_add(roundedSize(bytes), std::memory_order_relaxed);
+		liveBlocks.fetch_add(1, std::memory_order_relaxed);
+		return p;
+	}
+
+	void* map(std::size_t bytes, std::size_t alignment) {
+		std::size_t size = roundedSize(bytes);
+#ifdef __linux__
+		std::size_t align = huge ? hugePageSize : pageSize;
+		if (alignment > align) {
+			align = alignment;
+		}
+		// map more than needed and cut off what is not aligned:
+		std::size_t extra = align > pageSize ? align : 0;
+		void* mem = mmap(nullptr, size + extra, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (mem == MAP_FAILED) {
+			throw std::bad_alloc{};
+		}
+		auto addr = reinterpret_cast<std::uintptr_t>(mem);
+		auto start = (addr + align - 1) & ~(align - 1);
+		if (extra > 0) {
+			if (start > addr) {
+				munmap(mem, start - addr);
+			}
+			if (addr + extra > start) {
+				munmap(reinterpret_cast<void*>(start + size), addr + extra - start);
+			}
+		}
+		if (huge) {
+			madvise(reinterpret_cast<void*>(start), size, MADV_HUGEPAGE);
+		}
+		return reinterpret_cast<void*>(start);
+#else
+		std::size_t align = alignment > pageSize ? alignment : pageSize;
+		return ::operator new(size, std::align_val_t{ align });
+#endif
+	}
+
+	void do_deallocate(void* ptr, std::size_t bytes, std::size_t alignment)
+		override {
+		liveBytes.fetch_sub(bytes, std::memory_order_relaxed);
+		liveMapped.fetch_sub(roundedSize(bytes), std::memory_order_relaxed);
+		liveBlocks.fetch_sub(1, std::memory_order_relaxed);
+#ifdef __linux__
+		(void)alignment;
+		munmap(ptr, roundedSize(bytes));
+#else
+		std::size_t align = alignment > pageSize ? alignment : pageSize;
+		::operator delete(ptr, std::align_val_t{ align });
+#endif
+	}
+
+	bool do_is_equal(const std::pmr::memory_resource& other) const noexcept
+		override {
+		return this == &other;
+	}
+};
+
+#endif // PAGERESOURCE_HPP
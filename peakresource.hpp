@@ -0,0 +1,70 @@
+#ifndef PEAKRESOURCE_HPP
+#define PEAKRESOURCE_HPP
+
+#include <atomic>
+#include <memory_resource>
+#include "introspect.hpp"
+#include "threaddefault.hpp"
+
+// Counts the bytes the resource above it holds from upstream and the most
+// it held at once, its footprint as the OS sees it. Put it below a pool or
+// arena, e.g. to find the options that need the least memory at the peak.
+// The counting is atomic, it can be shared by threads if its upstream can.
+class PeakResource final : public introspectable_resource
+{
+private:
+	std::pmr::memory_resource* upstream;
+	std::atomic<std::size_t> cur{ 0 };
+	std::atomic<std::size_t> max{ 0 };
+	std::atomic<std::size_t> blocks{ 0 };
+
+public:
+	explicit PeakResource(std::pmr::memory_resource* us = get_thread_default())
+		: upstream{ us } {
+	}
+
+	PeakResource(const PeakResource&) = delete;
+	PeakResource& operator=(const PeakResource&) = delete;
+
+	std::size_t peak() const {
+		return max.load(std::memory_order_relaxed);
+	}
+
+	std::pmr::memory_resource* upstream_resource() const {
+		return upstream;
+	}
+
+	// what passed through and was not given back yet
+	ResourceStats stats() const override {
+		ResourceStats s;
+		s.bytesInUse = s.bytesReserved = cur.load(std::memory_order_relaxed);
+		s.chunks = blocks.load(std::memory_order_relaxed);
+		return s;
+	}
+
+private:
+	void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+		void* p = upstream->allocate(bytes, alignment);
+		std::size_t now = cur.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+		std::size_t old = max.load(std::memory_order_relaxed);
+		while (old < now
+			&& !max.compare_exchange_weak(old, now, std::memory_order_relaxed)) {
+		}
+		blocks.fetch_add(1, std::memory_order_relaxed);
+		return p;
+	}
+
+	void do_deallocate(void* ptr, std::size_t bytes, std::size_t alignment)
+		override {
+		cur.fetch_sub(bytes, std::memory_order_relaxed);
+		blocks.fetch_sub(1, std::memory_order_relaxed);
+		upstream->deallocate(ptr, bytes, alignment);
+	}
+
+	bool do_is_equal(const std::pmr::memory_resource& other) const noexcept
+		override {
+		return this == &other;
+	}
+};
+
+#endif // PEAKRESOURCE_HPP
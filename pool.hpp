@@ -0,0 +1,494 @@
+#ifndef POOL_HPP
+#define POOL_HPP
+
+#include <memory_resource>
+#include <array>
+#include <vector>
+#include <algorithm> // for std::sort() and std::upper_bound()
+#include <cstddef>   // for std::byte and std::max_align_t
+#include <cstdio>    // for printf()
+#include "introspect.hpp"
+#include "prewarm.hpp"
+#include "trim.hpp"
+#include "threaddefault.hpp"
+
+// How the free blocks of a pool are spread over its chunks. Free memory
+// in many partially used chunks can neither serve bigger requests nor go
+// back upstream: a pool that grows while its bytes in use don't is
+// fragmented, one whose bytes in use grow too leaks.
+struct PoolFragmentation {
+	struct SizeClass {
+		std::size_t blockSize = 0;
+		std::size_t chunks = 0;
+		std::size_t emptyChunks = 0;      // no block in use
+		std::size_t partialChunks = 0;    // some blocks in use, some free
+		std::size_t freeBlocks = 0;
+		std::size_t largestFreeRun = 0;   // most adjacent free blocks in a chunk
+		double external = 0;              // 1 - largestFreeRun / freeBlocks
+	};
+	std::vector<SizeClass> sizeClasses;
+	double partialChunkRatio = 0;         // partially used chunks / all chunks
+	std::size_t largestFreeRun = 0;       // in bytes, over all classes
+};
+
+inline void printFragmentation(const PoolFragmentation& f, const char* name = "") {
+	printf("%s%.1f%% of the chunks partially used, largest free run %zu bytes\n",
+		name, 100 * f.partialChunkRatio, f.largestFreeRun);
+	for (const auto& c : f.sizeClasses) {
+		if (c.chunks > 0) {
+			printf("%s  %6zu byte blocks: %zu chunks (%zu empty, %zu partial), "
+				"%zu free blocks, largest run %zu, external %.2f\n",
+				name, c.blockSize, c.chunks, c.emptyChunks, c.partialChunks,
+				c.freeBlocks, c.largestFreeRun, c.external);
+		}
+	}
+}
+
+// An unsynchronized pool like std::pmr::unsynchronized_pool_resource, but
+// final and in this tree, so it can be bound statically and looked into.
+// Blocks are powers of two from 8 bytes to largest_required_pool_block,
+// each size class carves them out of chunks that double in size up to
+// max_blocks_per_chunk blocks. Larger or over-aligned requests go straight
+// to upstream. Upstream is the type of that resource, as for BasicArena.
+template<typename Upstream>
+class BasicPool final : public introspectable_resource
+{
+private:
+	static constexpr std::size_t minBlock = 8;
+	static constexpr std::size_t maxClasses = 16;   // 8 bytes .. 256 KiB
+	static constexpr std::size_t maxBlocks = 65536;
+
+	struct Block {
+		Block* next;
+	};
+	// kept at the end of each chunk, behind its blocks
+	struct Chunk {
+		Chunk* next;
+		std::size_t bytes;         // total size including this header
+		std::size_t trimmed = 0;   // bytes given back to the OS by trim()
+	};
+	struct SizeClass {
+		std::size_t blockSize = 0;
+		Block* free = nullptr;        // given back blocks
+		std::byte* cur = nullptr;     // not yet used part of the newest chunk
+		std::byte* end = nullptr;
+		Chunk* chunks = nullptr;      // newest first
+		Chunk* trimmed = nullptr;     // without blocks, reused first
+		std::size_t nextBlocks = 0;   // blocks in the next chunk
+		std::size_t blocks = 0;       // in all chunks
+		std::size_t inUse = 0;        // blocks handed out
+		std::size_t requested = 0;    // bytes asked for by their users
+	};
+
+	Upstream* upstream;
+	std::pmr::pool_options opts;
+	std::array<SizeClass, maxClasses> classes;
+	std::size_t numClasses = 0;
+	std::size_t largeBytes = 0;     // passed to upstream as they are
+	std::size_t largeBlocks = 0;
+	std::size_t ops = 0;            // allocations and deallocations
+
+public:
+	explicit BasicPool(Upstream* us = get_thread_default())
+		: BasicPool{ std::pmr::pool_options{}, us } {
+	}
+
+	explicit BasicPool(const std::pmr::pool_options& o,
+		Upstream* us = get_thread_default())
+		: upstream{ us }, opts{ o } {
+		// zero means our default, too much the limit
+		if (opts.max_blocks_per_chunk == 0) {
+			opts.max_blocks_per_chunk = 1024;
+		}
+		if (opts.max_blocks_per_chunk > maxBlocks) {
+			opts.max_blocks_per_chunk = maxBlocks;
+		}
+		std::size_t largest = minBlock << (maxClasses - 1);
+		if (opts.largest_required_pool_block == 0) {
+			opts.largest_required_pool_block = 4096;
+		}
+		if (opts.largest_required_pool_block > largest) {
+			opts.largest_required_pool_block = largest;
+		}
+		for (std::size_t size = minBlock; ; size *= 2) {
+			SizeClass& c = classes[numClasses++];
+			c.blockSize = size;
+			c.nextBlocks = size < 1024 ? 1024 / size : 1;  // first chunk ~1 KiB
+			if (c.nextBlocks > opts.max_blocks_per_chunk) {
+				c.nextBlocks = opts.max_blocks_per_chunk;
+			}
+			if (size >= opts.largest_required_pool_block) {
+				break;
+			}
+		}
+		opts.largest_required_pool_block = classes[numClasses - 1].blockSize;
+	}
+
+	BasicPool(const BasicPool&) = delete;
+	BasicPool& operator=(const BasicPool&) = delete;
+
+	~BasicPool() {
+		release();
+	}
+
+	// hides memory_resource::allocate() for callers that know the type
+	// (see static_allocator), so the free list pop can be inlined
+	[[nodiscard]]
+	void* allocate(std::size_t bytes,
+		std::size_t alignment = alignof(std::max_align_t)) {
+		++ops;
+		SizeClass* c = classFor(bytes, alignment);
+		if (c == nullptr) {
+			void* p = upstream->allocate(bytes, alignment);
+			largeBytes += bytes;
+			++largeBlocks;
+			return p;
+		}
+		void* p = c->free;
+		if (p != nullptr) {
+			c->free = c->free->next;
+		}
+		else {
+			if (c->cur == c->end) {
+				refill(*c);   // may throw, so count the block only after it
+			}
+			p = c->cur;
+			c->cur += c->blockSize;
+		}
+		++c->inUse;
+		c->requested += bytes;
+		return p;
+	}
+
+	void deallocate(void* ptr, std::size_t bytes,
+		std::size_t alignment = alignof(std::max_align_t)) {
+		++ops;
+		SizeClass* c = classFor(bytes, alignment);
+		if (c == nullptr) {
+			upstream->deallocate(ptr, bytes, alignment);
+			largeBytes -= bytes;
+			--largeBlocks;
+			return;
+		}
+		--c->inUse;
+		c->requested -= bytes;
+		Block* b = static_cast<Block*>(ptr);
+		b->next = c->free;
+		c->free = b;
+	}
+
+	// makes sure count blocks for size are free, taking the missing ones
+	// from trimmed chunks first, then from upstream in one chunk
+	// (max_blocks_per_chunk doesn't limit it); false for sizes that go to
+	// upstream anyway
+	bool reserve(std::size_t size, std::size_t count,
+		std::size_t alignment = alignof(std::max_align_t)) {
+		SizeClass* c = classFor(size, alignment);
+		if (c == nullptr) {
+			return false;
+		}
+		std::size_t available = c->blocks - c->inUse;
+		while (available < count && c->trimmed != nullptr) {
+			available += capacity(*c, c->trimmed);
+			reuseTrimmed(*c);
+		}
+		if (available < count) {
+			addChunk(*c, count - available);
+		}
+		return true;
+	}
+
+	void prewarm(const PoolProfile& p) {
+		for (const auto& e : p.entries) {
+			reserve(e.size, e.count, e.alignment);
+		}
+	}
+
+	// gives the pages of the chunks without a block in use back to the OS
+	// (see trim.hpp) and keeps the chunks for later, returns the bytes
+	std::size_t trim(TrimMode mode = TrimMode::dontNeed) {
+		std::size_t ret = 0;
+		for (std::size_t i = 0; i < numClasses; ++i) {
+			ret += trimClass(classes[i], mode);
+		}
+		return ret;
+	}
+
+	// changes with every allocation and deallocation (see IdleTrimmer)
+	std::size_t activity() const {
+		return ops;
+	}
+
+	// give all chunks back to upstream, blocks larger than the largest
+	// class have to be deallocated by their users
+	void release() noexcept {
+		for (std::size_t i = 0; i < numClasses; ++i) {
+			SizeClass& c = classes[i];
+			for (Chunk* list : { c.chunks, c.trimmed }) {
+				for (Chunk* ch = list; ch != nullptr; ) {
+					Chunk* next = ch->next;
+					upstream->deallocate(chunkBegin(ch), ch->bytes, chunkAlign(c));
+					ch = next;
+				}
+			}
+			c.free = nullptr;
+			c.cur = c.end = nullptr;
+			c.chunks = c.trimmed = nullptr;
+			c.blocks = c.inUse = c.requested = 0;
+		}
+	}
+
+	Upstream* upstream_resource() const {
+		return upstream;
+	}
+
+	std::pmr::pool_options options() const {
+		return opts;
+	}
+
+	// blocks larger than the largest class count as one chunk each,
+	// trimmed chunks are still reserved
+	ResourceStats stats() const override {
+		ResourceStats s;
+		s.bytesInUse = largeBytes;
+		s.bytesReserved = largeBytes;
+		s.chunks = largeBlocks;
+		for (std::size_t i = 0; i < numClasses; ++i) {
+			const SizeClass& c = classes[i];
+			for (Chunk* ch = c.chunks; ch != nullptr; ch = ch->next) {
+				++s.chunks;
+				s.bytesReserved += ch->bytes;
+			}
+			for (Chunk* ch = c.trimmed; ch != nullptr; ch = ch->next) {
+				++s.chunks;
+				s.bytesReserved += ch->bytes;
+				s.bytesTrimmed += ch->trimmed;
+			}
+			s.bytesInUse += c.requested;
+			s.tailWaste += c.inUse * c.blockSize - c.requested;
+			s.sizeClasses.push_back({ c.blockSize, c.blocks, c.inUse });
+		}
+		return s;
+	}
+
+	// walks all free lists and chunks: for diagnostics, not hot paths
+	PoolFragmentation fragmentation() const {
+		PoolFragmentation f;
+		std::size_t allChunks = 0, partial = 0;
+		for (std::size_t i = 0; i < numClasses; ++i) {
+			const SizeClass& c = classes[i];
+			PoolFragmentation::SizeClass fc;
+			fc.blockSize = c.blockSize;
+
+			// which blocks of which chunk are free, chunks by address:
+			std::vector<Chunk*> chunks;
+			for (Chunk* ch = c.chunks; ch != nullptr; ch = ch->next) {
+				chunks.push_back(ch);
+			}
+			std::sort(chunks.begin(), chunks.end(), [](Chunk* a, Chunk* b) {
+				return chunkBegin(a) < chunkBegin(b);
+			});
+			std::vector<std::vector<bool>> free;
+			for (Chunk* ch : chunks) {
+				free.emplace_back((ch->bytes - sizeof(Chunk)) / c.blockSize, false);
+			}
+			auto markFree = [&](const std::byte* p) {
+				auto it = std::upper_bound(chunks.begin(), chunks.end(), p,
+					[](const std::byte* q, Chunk* ch) { return q < chunkBegin(ch); });
+				if (it != chunks.begin()) {
+					std::size_t k = static_cast<std::size_t>(it - chunks.begin()) - 1;
+					std::size_t idx = static_cast<std::size_t>(p - chunkBegin(chunks[k]))
+						/ c.blockSize;
+					if (idx < free[k].size()) {
+						free[k][idx] = true;
+					}
+				}
+			};
+			for (Block* b = c.free; b != nullptr; b = b->next) {
+				markFree(reinterpret_cast<const std::byte*>(b));
+			}
+			for (const std::byte* p = c.cur; p < c.end; p += c.blockSize) {
+				markFree(p);   // not carved out yet
+			}
+
+			for (const std::vector<bool>& blocks : free) {
+				std::size_t numFree = 0, run = 0;
+				for (bool isFree : blocks) {
+					run = isFree ? run + 1 : 0;
+					numFree += isFree;
+					fc.largestFreeRun = std::max(fc.largestFreeRun, run);
+				}
+				++fc.chunks;
+				fc.freeBlocks += numFree;
+				if (numFree == blocks.size()) {
+					++fc.emptyChunks;
+				}
+				else if (numFree > 0) {
+					++fc.partialChunks;
+				}
+			}
+			fc.external = fc.freeBlocks
+				? 1 - double(fc.largestFreeRun) / fc.freeBlocks : 0;
+			f.largestFreeRun = std::max(f.largestFreeRun, fc.largestFreeRun * c.blockSize);
+			allChunks += fc.chunks;
+			partial += fc.partialChunks;
+			f.sizeClasses.push_back(fc);
+		}
+		f.partialChunkRatio = allChunks ? double(partial) / allChunks : 0;
+		return f;
+	}
+
+private:
+	// chunks are aligned like the blocks in them need, up to max_align_t
+	static std::size_t chunkAlign(const SizeClass& c) {
+		return c.blockSize < alignof(std::max_align_t) ? c.blockSize
+			: alignof(std::max_align_t);
+	}
+
+	static std::byte* chunkBegin(Chunk* ch) {
+		return reinterpret_cast<std::byte*>(ch + 1) - ch->bytes;
+	}
+
+	// size class for a request, or nullptr if it goes upstream
+	SizeClass* classFor(std::size_t bytes, std::size_t alignment) {
+		if (alignment > alignof(std::max_align_t)) {
+			return nullptr;
+		}
+		std::size_t size = bytes > alignment ? bytes : alignment;
+		for (std::size_t i = 0; i < numClasses; ++i) {
+			if (size <= classes[i].blockSize) {
+				return &classes[i];
+			}
+		}
+		return nullptr;
+	}
+
+	void refill(SizeClass& c) {
+		if (c.trimmed != nullptr) {
+			reuseTrimmed(c);
+			return;
+		}
+		std::size_t blocks = c.nextBlocks;
+		addChunk(c, blocks);
+		if (blocks * 2 <= opts.max_blocks_per_chunk) {
+			c.nextBlocks = blocks * 2;
+		}
+	}
+
+	void addChunk(SizeClass& c, std::size_t blocks) {
+		// a multiple of the alignment, as aligned_alloc() wants it, the header
+		// at the end, so the padding stays less than a block
+		std::size_t bytes = (blocks * c.blockSize + sizeof(Chunk) + chunkAlign(c) - 1)
+			& ~(chunkAlign(c) - 1);
+		std::byte* mem = static_cast<std::byte*>(upstream->allocate(bytes, chunkAlign(c)));
+		c.chunks = ::new (mem + bytes - sizeof(Chunk)) Chunk{ c.chunks, bytes };
+		carve(c, mem, blocks);
+	}
+
+	// the most recently trimmed chunk becomes the newest again, its pages
+	// come back zeroed as they are touched
+	void reuseTrimmed(SizeClass& c) {
+		Chunk* ch = c.trimmed;
+		c.trimmed = ch->next;
+		ch->next = c.chunks;
+		ch->trimmed = 0;
+		c.chunks = ch;
+		carve(c, chunkBegin(ch), capacity(c, ch));
+	}
+
+	// blocks not carved out of the newest chunk yet go to the free list
+	void carve(SizeClass& c, std::byte* mem, std::size_t blocks) {
+		for (; c.cur != c.end; c.cur += c.blockSize) {
+			c.free = ::new (c.cur) Block{ c.free };
+		}
+		c.cur = mem;
+		c.end = mem + blocks * c.blockSize;
+		c.blocks += blocks;
+	}
+
+	static std::size_t capacity(const SizeClass& c, const Chunk* ch) {
+		return (ch->bytes - sizeof(Chunk)) / c.blockSize;
+	}
+
+	// moves the chunks of c without a block in use to its trimmed ones
+	std::size_t trimClass(SizeClass& c, TrimMode mode) {
+		if (c.chunks == nullptr || c.inUse == c.blocks) {
+			return 0;
+		}
+		std::vector<Chunk*> chunks;
+		for (Chunk* ch = c.chunks; ch != nullptr; ch = ch->next) {
+			chunks.push_back(ch);
+		}
+		std::sort(chunks.begin(), chunks.end(), [](Chunk* a, Chunk* b) {
+			return chunkBegin(a) < chunkBegin(b);
+		});
+		auto indexOf = [&](const void* p) {
+			auto it = std::upper_bound(chunks.begin(), chunks.end(),
+				static_cast<const std::byte*>(p),
+				[](const std::byte* q, Chunk* ch) { return q < chunkBegin(ch); });
+			return static_cast<std::size_t>(it - chunks.begin()) - 1;
+		};
+		std::vector<std::size_t> free(chunks.size());
+		for (Block* b = c.free; b != nullptr; b = b->next) {
+			++free[indexOf(b)];
+		}
+		if (c.cur != c.end) {
+			free[indexOf(c.cur)] += static_cast<std::size_t>(c.end - c.cur) / c.blockSize;
+		}
+		std::vector<bool> empty(chunks.size());
+		bool any = false;
+		for (std::size_t k = 0; k < chunks.size(); ++k) {
+			empty[k] = free[k] == capacity(c, chunks[k]);
+			any = any || empty[k];
+		}
+		if (!any) {
+			return 0;
+		}
+
+		// none of their blocks may be handed out anymore:
+		for (Block** link = &c.free; *link != nullptr; ) {
+			if (empty[indexOf(*link)]) {
+				*link = (*link)->next;
+			}
+			else {
+				link = &(*link)->next;
+			}
+		}
+		if (c.cur != c.end && empty[indexOf(c.cur)]) {
+			c.cur = c.end = nullptr;
+		}
+		std::size_t ret = 0;
+		for (Chunk** link = &c.chunks; *link != nullptr; ) {
+			Chunk* ch = *link;
+			if (!empty[indexOf(chunkBegin(ch))]) {
+				link = &ch->next;
+				continue;
+			}
+			*link = ch->next;
+			ch->next = c.trimmed;
+			c.trimmed = ch;
+			c.blocks -= capacity(c, ch);
+			ch->trimmed = trimPages(chunkBegin(ch), capacity(c, ch) * c.blockSize, mode);
+			ret += ch->trimmed;
+		}
+		return ret;
+	}
+
+	void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+		return allocate(bytes, alignment);
+	}
+
+	void do_deallocate(void* ptr, std::size_t bytes, std::size_t alignment)
+		override {
+		deallocate(ptr, bytes, alignment);
+	}
+
+	bool do_is_equal(const std::pmr::memory_resource& other) const noexcept
+		override {
+		return this == &other;
+	}
+};
+
+using Pool = BasicPool<std::pmr::memory_resource>;
+
+#endif // POOL_HPP
@@ -0,0 +1,61 @@
+#ifndef PREWARM_HPP
+#define PREWARM_HPP
+
+#include <memory_resource>
+#include <vector>
+#include <cstddef>   // for std::max_align_t
+#include "introspect.hpp"
+
+// How many blocks of each size a pool should have ready before the first
+// request. Without them the first requests after startup take chunk after
+// growing chunk from upstream (see the first iterations of main() in
+// mainoutput.txt) before the pool reaches its steady state.
+struct PoolProfile {
+	struct Entry {
+		std::size_t size;
+		std::size_t count;
+		std::size_t alignment = alignof(std::max_align_t);
+	};
+	std::vector<Entry> entries;
+
+	PoolProfile& add(std::size_t size, std::size_t count,
+		std::size_t alignment = alignof(std::max_align_t)) {
+		entries.push_back(Entry{ size, count, alignment });
+		return *this;
+	}
+};
+
+// what a pool took after a representative run: the blocks of each of its
+// size classes (pools don't give blocks back before release()). Aligned
+// only as their blocks are, 8 byte blocks would warm the 16 byte class.
+inline PoolProfile profileOf(const ResourceStats& s) {
+	PoolProfile p;
+	for (const auto& c : s.sizeClasses) {
+		if (c.blocks > 0) {
+			p.add(c.blockSize, c.blocks, c.blockSize < alignof(std::max_align_t)
+				? c.blockSize : alignof(std::max_align_t));
+		}
+	}
+	return p;
+}
+
+// for resources without a prewarm() of their own, like the standard
+// pools: allocates the blocks and gives them back, a pool keeps them
+inline void prewarm(std::pmr::memory_resource* res, const PoolProfile& p) {
+	struct Block {
+		void* ptr;
+		std::size_t size;
+		std::size_t alignment;
+	};
+	std::vector<Block> blocks;
+	for (const auto& e : p.entries) {
+		for (std::size_t i = 0; i < e.count; ++i) {
+			blocks.push_back(Block{ res->allocate(e.size, e.alignment), e.size, e.alignment });
+		}
+	}
+	for (const Block& b : blocks) {
+		res->deallocate(b.ptr, b.size, b.alignment);
+	}
+}
+
+#endif // PREWARM_HPP
@@ -0,0 +1,163 @@
+#ifndef REPLAY_HPP
+#define REPLAY_HPP
+
+#include <memory_resource>
+#include <vector>
+#include <unordered_map>
+#include <iostream>
+#include <string>
+#include <stdexcept>   // for std::runtime_error
+#include "introspect.hpp"
+#include "threaddefault.hpp"
+
+// The allocations and deallocations a program made, recorded by a
+// TraceRecorder in its chain, saved, and replayed on any resource later
+// to see how that copes with exactly this workload.
+
+struct TraceEvent {
+	bool allocate;
+	std::size_t id;          // pairs a deallocation with its allocation
+	std::size_t bytes;
+	std::size_t alignment;
+};
+
+using Trace = std::vector<TraceEvent>;
+
+// passes everything on to upstream and records it
+class TraceRecorder final : public introspectable_resource
+{
+private:
+	std::pmr::memory_resource* upstream;
+	Trace events;
+	std::unordered_map<void*, std::size_t> ids;   // of the live blocks
+	std::size_t nextId = 0;
+	std::size_t liveBytes = 0;
+
+public:
+	explicit TraceRecorder(std::pmr::memory_resource* us = get_thread_default())
+		: upstream{ us } {
+	}
+
+	const Trace& trace() const {
+		return events;
+	}
+
+	std::pmr::memory_resource* upstream_resource() const {
+		return upstream;
+	}
+
+	// what passed through and was not given back yet
+	ResourceStats stats() const override {
+		ResourceStats s;
+		s.bytesInUse = s.bytesReserved = liveBytes;
+		s.chunks = ids.size();
+		return s;
+	}
+
+private:
+	void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+		void* p = upstream->allocate(bytes, alignment);
+		ids[p] = nextId;
+		events.push_back(TraceEvent{ true, nextId++, bytes, alignment });
+		liveBytes += bytes;
+		return p;
+	}
+
+	void do_deallocate(void* ptr, std::size_t bytes, std::size_t alignment)
+		override {
+		auto it = ids.find(ptr);
+		if (it != ids.end()) {
+			events.push_back(TraceEvent{ false, it->second, bytes, alignment });
+			ids.erase(it);
+			liveBytes -= bytes;
+		}
+		upstream->deallocate(ptr, bytes, alignment);
+	}
+
+	bool do_is_equal(const std::pmr::memory_resource& other) const noexcept
+		override {
+		return this == &other;
+	}
+};
+
+// one event per line: "a <id> <bytes> <alignment>" or "d <id> <bytes> <alignment>"
+inline void saveTrace(std::ostream& os, const Trace& trace) {
+	for (const TraceEvent& e : trace) {
+		os << (e.allocate ? 'a' : 'd') << ' ' << e.id << ' ' << e.bytes << ' '
+			<< e.alignment << '\n';
+	}
+}
+
+inline Trace loadTrace(std::istream& is) {
+	Trace trace;
+	char op;
+	TraceEvent e;
+	while (is >> op >> e.id >> e.bytes >> e.alignment) {
+		if (op != 'a' && op != 'd') {
+			throw std::runtime_error{ "trace: bad event '" + std::string(1, op) + "'" };
+		}
+		e.allocate = op == 'a';
+		trace.push_back(e);
+	}
+	if (!is.eof()) {
+		throw std::runtime_error{ "trace: bad line after event "
+			+ std::to_string(trace.size()) };
+	}
+	return trace;
+}
+
+// what the trace allocated but never gave back
+struct ReplayResult {
+	std::size_t liveBlocks = 0;
+	std::size_t liveBytes = 0;
+};
+
+// plays trace on res, calling every(i) after each interval-th event i
+// (if interval > 0). What the trace leaves allocated is given back at the
+// end when freeRest is set.
+template<typename F>
+ReplayResult replay(const Trace& trace, std::pmr::memory_resource* res,
+	std::size_t interval, F every, bool freeRest = true) {
+	struct Live {
+		void* p = nullptr;
+		std::size_t bytes = 0;
+		std::size_t alignment = 0;
+	};
+	std::vector<Live> live;
+	ReplayResult r;
+	for (std::size_t i = 0; i < trace.size(); ++i) {
+		const TraceEvent& e = trace[i];
+		if (e.id >= live.size()) {
+			live.resize(e.id + 1);
+		}
+		Live& l = live[e.id];
+		if (e.allocate && l.p == nullptr) {
+			l = Live{ res->allocate(e.bytes, e.alignment), e.bytes, e.alignment };
+			++r.liveBlocks;
+			r.liveBytes += e.bytes;
+		}
+		else if (!e.allocate && l.p != nullptr) {
+			res->deallocate(l.p, l.bytes, l.alignment);
+			l.p = nullptr;
+			--r.liveBlocks;
+			r.liveBytes -= l.bytes;
+		}
+		if (interval > 0 && (i + 1) % interval == 0) {
+			every(i + 1);
+		}
+	}
+	if (freeRest) {
+		for (Live& l : live) {
+			if (l.p != nullptr) {
+				res->deallocate(l.p, l.bytes, l.alignment);
+			}
+		}
+	}
+	return r;
+}
+
+inline ReplayResult replay(const Trace& trace, std::pmr::memory_resource* res) {
+	return replay(trace, res, 0, [](std::size_t) {});
+}
+
+#endif // REPLAY_HPP
@@ -0,0 +1,247 @@
+#ifndef RUNNER_HPP
+#define RUNNER_HPP
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <thread>
+#include <memory>      // for std::unique_ptr
+#include <stdexcept>   // for std::invalid_argument
+#include <new>         // for std::bad_alloc
+#include <exception>   // for std::exception_ptr
+#include "benchmark.hpp"
+#include "scenarios.hpp"
+#include "chainspec.hpp"
+#include "threaddefault.hpp"
+
+// Runs what scenarios.hpp offers with parameters from the command line and
+// prints a table or JSON (see writeJson() in benchmark.hpp), so parameters
+// can be swept by scripts and the results of two builds compared.
+//
+//   --scenario a,b,...   workloads (vector, map, unordered_map, list,
+//                        reused_vectors) or Source.cpp examples by name,
+//                        "all" for every one (default: vector)
+//   --chain spec         resource chain of the workloads, see chainspec.hpp
+//                        (default: the default resource); the examples
+//                        bring their own resources and ignore it
+//   --elements 1000,...  elements per run
+//   --strlen 21,...      length of the strings of the workloads
+//   --threads 1,...      threads running the scenario at once
+//   --reps n --warmup n  timed and untimed runs
+//   --json file          write JSON to file, "-" for stdout instead of the table
+//   --list               print the scenario names
+//
+// Every run gets a fresh chain, built outside the timing. What its trackers
+// print is timed, as part of their cost, and goes to stderr with --json -.
+// Threads share it, so with more than one thread only trackers and budgets
+// may lie above its first sync_pool (or it has only those).
+// Allocation counts, page faults and perf counters cover all threads.
+inline int runFromCommandLine(int argc, char* argv[]) {
+	std::vector<std::string> names{ "vector" };
+	std::string chain, jsonFile;
+	std::vector<int> elements{ 1000 }, strlens{ 21 }, threads{ 1 };
+	BenchConfig cfg;
+
+	try {
+		BenchArgs args{ argc, argv };
+		while (args.next()) {
+			if (args.is("--list")) {
+				for (const auto& w : scenarios::workloads()) {
+					std::cout << w.name << '\n';
+				}
+				for (const auto& sc : scenarios::all()) {
+					std::cout << sc.name << '\n';
+				}
+				return 0;
+			}
+			if (args.is("--scenario")) {
+				names = args.list();
+			}
+			else if (args.is("--chain")) {
+				chain = args.value();
+			}
+			else if (args.is("--elements")) {
+				elements = args.numbers(1, 100000000);
+			}
+			else if (args.is("--strlen")) {
+				strlens = args.numbers(0, 1 << 20);
+			}
+			else if (args.is("--threads")) {
+				threads = args.numbers(1, 1024);
+			}
+			else if (args.is("--reps")) {
+				cfg.repetitions = args.number(1, 1000000);
+			}
+			else if (args.is("--warmup")) {
+				cfg.warmup = args.number(0, 1000000);
+			}
+			else if (args.is("--json")) {
+				jsonFile = args.value();
+			}
+			else {
+				args.unknown();
+			}
+		}
+	}
+	catch (const std::invalid_argument& e) {
+		std::cerr << e.what() << '\n';
+		return 1;
+	}
+
+	if (names.size() == 1 && names.front() == "all") {
+		names.clear();
+		for (const auto& w : scenarios::workloads()) {
+			names.push_back(w.name);
+		}
+		for (const auto& sc : scenarios::all()) {
+			names.push_back(sc.name);
+		}
+	}
+	for (const std::string& name : names) {
+		bool known = false;
+		for (const auto& w : scenarios::workloads()) {
+			known = known || name == w.name;
+		}
+		for (const auto& sc : scenarios::all()) {
+			known = known || name == sc.name;
+		}
+		if (!known) {
+			std::cerr << "unknown scenario " << name << " (see --list)\n";
+			return 1;
+		}
+	}
+	if (!chain.empty()) {
+		try {
+			ResourceChain check{ chain };
+			// a sync_pool serializes what lies below it, trackers and
+			// budgets count atomically
+			bool shared = true;
+			for (const std::string& layer : check.layerNames()) {
+				if (layer == "sync_pool") {
+					break;
+				}
+				shared = shared && (layer == "tracker" || layer == "budget");
+			}
+			for (int n : threads) {
+				if (n > 1 && !shared) {
+					std::cerr << "threads need a sync_pool above unsynchronized layers\n";
+					return 1;
+				}
+			}
+		}
+		catch (const std::invalid_argument& e) {
+			std::cerr << e.what() << '\n';
+			return 1;
+		}
+		catch (const std::bad_alloc&) {
+			std::cerr << "chain " << chain << ": out of memory\n";
+			return 1;
+		}
+	}
+
+	bool table = jsonFile != "-";
+	// tracker layers must not print into JSON on stdout
+	std::ostream& log = table ? std::cout : std::cerr;
+	std::vector<BenchResult> results;
+	if (table) {
+		printHeader();
+	}
+	for (const std::string& name : names) {
+		const scenarios::Workload* workload = nullptr;
+		for (const auto& w : scenarios::workloads()) {
+			workload = name == w.name ? &w : workload;
+		}
+		const scenarios::Scenario* example = nullptr;
+		for (const auto& sc : scenarios::all()) {
+			example = name == sc.name ? &sc : example;
+		}
+		for (int num : elements) {
+			// the examples have no string length to vary
+			for (std::size_t s = 0; s < (workload ? strlens.size() : 1); ++s) {
+				for (int n : threads) {
+					int strlen = strlens[s];
+					// a fresh chain for every run, built and torn down
+					// outside the timing
+					std::unique_ptr<ResourceChain> rc;
+					std::pmr::memory_resource* res = get_thread_default();
+					auto setup = [&] {
+						if (workload && !chain.empty()) {
+							rc.reset();
+							rc = std::make_unique<ResourceChain>(chain, log);
+							res = rc->top();
+						}
+					};
+					auto run = [&] {
+						auto once = [&] {
+							if (workload) {
+								workload->run(res, num, strlen);
+							}
+							else {
+								example->run(num);
+							}
+						};
+						if (n <= 1) {
+							once();
+							return;
+						}
+						// what a thread throws is rethrown here, after all
+						// of them are done with the chain
+						std::vector<std::exception_ptr> errors(n);
+						std::vector<std::thread> ts;
+						for (int t = 0; t < n; ++t) {
+							ts.emplace_back([&, t] {
+								try {
+									once();
+								}
+								catch (...) {
+									errors[t] = std::current_exception();
+								}
+							});
+						}
+						for (auto& t : ts) {
+							t.join();
+						}
+						for (const std::exception_ptr& e : errors) {
+							if (e) {
+								std::rethrow_exception(e);
+							}
+						}
+					};
+
+					std::vector<std::pair<std::string, std::string>> params{
+						{ "elements", std::to_string(num) } };
+					if (workload) {
+						params.emplace_back("chain", chain.empty() ? "default" : chain);
+						params.emplace_back("strlen", std::to_string(strlen));
+					}
+					params.emplace_back("threads", std::to_string(n));
+					int rounds = workload ? workload->rounds : example->rounds;
+					try {
+						results.push_back(runBenchmark(name, std::move(params),
+							static_cast<std::size_t>(num) * rounds * (n > 1 ? n : 1), cfg, setup, run));
+					}
+					catch (const std::bad_alloc&) {
+						// e.g. over the limit of a budget in the chain
+						std::cerr << name << " with " << num << " elements: out of memory\n";
+						continue;
+					}
+					if (table) {
+						printResult(results.back());
+					}
+				}
+			}
+		}
+	}
+
+	if (jsonFile == "-") {
+		writeJson(std::cout, "runner", results);
+	}
+	else if (!jsonFile.empty()) {
+		std::ofstream out{ jsonFile };
+		writeJson(out, "runner", results);
+	}
+	return 0;
+}
+
+#endif // RUNNER_HPP
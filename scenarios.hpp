@@ -0,0 +1,199 @@
+#ifndef SCENARIOS_HPP
+#define SCENARIOS_HPP
+
+#include <vector>
+#include <string>
+#include <map>
+#include <list>
+#include <unordered_map>
+#include <array>
+#include <new>       // for std::bad_alloc
+#include <memory_resource>
+#include <cstddef>   // for std::byte
+
+// The examples of Source.cpp without their output and with the number of
+// elements as a parameter, so they can be run and timed by the
+// benchmarks. Each returns something derived from its containers so the
+// work can't be optimized away.
+namespace scenarios {
+
+inline const char* const text = "just a non-SSO string";
+
+inline std::size_t whyRegularAllocationBad(int num) {
+	std::vector<std::string> coll;
+	for (int i = 0; i < num; ++i) {
+		coll.emplace_back(text);
+	}
+	return coll.size();
+}
+
+inline std::size_t aLittleBetterWithPmr(int num) {
+	std::array<std::byte, 200000> buf;
+	std::pmr::monotonic_buffer_resource pool{ buf.data(), buf.size() };
+	std::pmr::vector<std::string> coll{ &pool };
+	for (int i = 0; i < num; ++i) {
+		coll.emplace_back(text);
+	}
+	return coll.size();
+}
+
+inline std::size_t dontAllocateOnTheHeapAtAll(int num) {
+	std::array<std::byte, 200000> buf;
+	std::pmr::monotonic_buffer_resource pool{ buf.data(), buf.size() };
+	std::pmr::vector<std::pmr::string> coll{ &pool };
+	for (int i = 0; i < num; ++i) {
+		coll.emplace_back(text);
+	}
+	return coll.size();
+}
+
+// five rounds of num, 2*num, ... elements on the same buffer
+inline std::size_t reUsingMemoryPools(int num) {
+	std::array<std::byte, 200000> buf;
+	std::size_t total = 0;
+	for (int round = 1; round <= 5; ++round) {
+		std::pmr::monotonic_buffer_resource pool{ buf.data(), buf.size() };
+		std::pmr::vector<std::pmr::string> col{ &pool };
+		for (int i = 0; i < num * round; ++i) {
+			col.emplace_back(text);
+		}
+		total += col.size();
+	}
+	return total;
+}
+
+inline std::size_t skipDeallocations(int num) {
+	std::pmr::monotonic_buffer_resource pool;
+	std::pmr::vector<std::pmr::string> coll{ &pool };
+	for (int i = 0; i < num; ++i) {
+		coll.emplace_back(text);
+	}
+	std::size_t n = coll.size();
+	coll.clear();
+	return n;
+}
+
+// 100 rounds of num elements
+inline std::size_t chainMemRes(int num) {
+	std::pmr::monotonic_buffer_resource keepAllocatedPool{ 10000 };
+	std::pmr::synchronized_pool_resource pool{ &keepAllocatedPool };
+	std::size_t total = 0;
+	for (int j = 0; j < 100; ++j) {
+		std::pmr::vector<std::pmr::string> coll{ &pool };
+		for (int i = 0; i < num; ++i) {
+			coll.emplace_back(text);
+		}
+		total += coll.size();
+	}
+	return total;
+}
+
+// stops at the first bad_alloc like the example
+inline std::size_t exampleNMR(int num) {
+	std::array<std::byte, 200000> buf;
+	std::pmr::monotonic_buffer_resource pool{ buf.data(), buf.size(),
+		std::pmr::null_memory_resource() };
+	std::pmr::unordered_map<long, std::pmr::string> coll{ &pool };
+	try {
+		for (int i = 0; i < num; ++i) {
+			std::string a{ "Customer" + std::to_string(i) };
+			coll.emplace(i, a);
+		}
+	}
+	catch (const std::bad_alloc&) {
+	}
+	return coll.size();
+}
+
+struct Scenario {
+	const char* name;
+	std::size_t (*run)(int num);
+	int rounds;            // elements per run are num * rounds
+};
+
+inline const std::vector<Scenario>& all() {
+	static const std::vector<Scenario> list{
+		{ "whyRegularAllocationBad", whyRegularAllocationBad, 1 },
+		{ "aLittleBetterWithPmr", aLittleBetterWithPmr, 1 },
+		{ "dontAllocateOnTheHeapAtAll", dontAllocateOnTheHeapAtAll, 1 },
+		{ "reUsingMemoryPools", reUsingMemoryPools, 15 },
+		{ "skipDeallocations", skipDeallocations, 1 },
+		{ "chainMemRes", chainMemRes, 100 },
+		{ "exampleNMR", exampleNMR, 1 },
+	};
+	return list;
+}
+
+// Workloads that take their memory resource and string length from the
+// caller, so the same work can run on any chain (see chainspec.hpp).
+
+inline std::size_t vectorOfStrings(std::pmr::memory_resource* res, int num,
+	std::size_t strlen) {
+	std::pmr::vector<std::pmr::string> coll{ res };
+	for (int i = 0; i < num; ++i) {
+		coll.emplace_back(strlen, 'x');
+	}
+	return coll.size();
+}
+
+inline std::size_t mapOfStrings(std::pmr::memory_resource* res, int num,
+	std::size_t strlen) {
+	std::pmr::map<long, std::pmr::string> coll{ res };
+	for (int i = 0; i < num; ++i) {
+		coll.emplace(i, std::pmr::string(strlen, 'x', res));
+	}
+	return coll.size();
+}
+
+inline std::size_t unorderedMapOfStrings(std::pmr::memory_resource* res, int num,
+	std::size_t strlen) {
+	std::pmr::unordered_map<long, std::pmr::string> coll{ res };
+	for (int i = 0; i < num; ++i) {
+		coll.emplace(i, std::pmr::string(strlen, 'x', res));
+	}
+	return coll.size();
+}
+
+inline std::size_t listOfStrings(std::pmr::memory_resource* res, int num,
+	std::size_t strlen) {
+	std::pmr::list<std::pmr::string> coll{ res };
+	for (int i = 0; i < num; ++i) {
+		coll.emplace_back(strlen, 'x');
+	}
+	return coll.size();
+}
+
+// 100 rounds of num elements, like chainMemRes()
+inline std::size_t reusedVectors(std::pmr::memory_resource* res, int num,
+	std::size_t strlen) {
+	std::size_t total = 0;
+	for (int j = 0; j < 100; ++j) {
+		std::pmr::vector<std::pmr::string> coll{ res };
+		for (int i = 0; i < num; ++i) {
+			coll.emplace_back(strlen, 'x');
+		}
+		total += coll.size();
+	}
+	return total;
+}
+
+struct Workload {
+	const char* name;
+	std::size_t (*run)(std::pmr::memory_resource* res, int num, std::size_t strlen);
+	int rounds;
+};
+
+inline const std::vector<Workload>& workloads() {
+	static const std::vector<Workload> list{
+		{ "vector", vectorOfStrings, 1 },
+		{ "map", mapOfStrings, 1 },
+		{ "unordered_map", unorderedMapOfStrings, 1 },
+		{ "list", listOfStrings, 1 },
+		{ "reused_vectors", reusedVectors, 100 },
+	};
+	return list;
+}
+
+} // namespace scenarios
+
+#endif // SCENARIOS_HPP
@@ -0,0 +1,128 @@
+#ifndef SCRATCHSTACK_HPP
+#define SCRATCHSTACK_HPP
+
+#include <memory_resource>
+#include <memory>    // for std::align()
+#include <cstddef>   // for std::byte and std::max_align_t
+#include "introspect.hpp"
+#include "threaddefault.hpp"
+
+// A LIFO allocator for short-lived temporaries: one big region per thread
+// (taken from upstream on first use, not from the call stack), a top
+// pointer that is bumped on allocate and moved back when the most recent
+// block is deallocated, and Scope frames that pop everything allocated
+// inside them at once.
+class ScratchStack final : public introspectable_resource
+{
+public:
+	static constexpr std::size_t defaultSize = 4 * 1024 * 1024;
+
+	// remembers the top on construction and pops back to it on destruction.
+	// Scopes of one stack have to be nested.
+	class Scope {
+	private:
+		ScratchStack& stack;
+		std::size_t saved;   // an offset, the region may not exist yet
+	public:
+		explicit Scope(ScratchStack& s = ScratchStack::local())
+			: stack{ s }, saved{ s.used() } {
+		}
+		~Scope() {
+			stack.top = stack.begin + saved;
+		}
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+	};
+
+private:
+	std::pmr::memory_resource* upstream;
+	std::size_t size;
+	std::byte* begin = nullptr;
+	std::byte* top = nullptr;
+	std::byte* end = nullptr;
+	std::size_t largeBytes = 0;    // too big for the region, from upstream
+	std::size_t largeBlocks = 0;
+
+public:
+	explicit ScratchStack(std::size_t sz = defaultSize,
+		std::pmr::memory_resource* us = get_thread_default())
+		: upstream{ us }, size{ sz } {
+	}
+
+	ScratchStack(const ScratchStack&) = delete;
+	ScratchStack& operator=(const ScratchStack&) = delete;
+
+	~ScratchStack() {
+		if (begin != nullptr) {
+			upstream->deallocate(begin, size, alignof(std::max_align_t));
+		}
+	}
+
+	// the scratch stack of the calling thread. It lives until the thread
+	// ends, so it must not take its region from a resource that a
+	// scoped_default_resource set only for a while.
+	static ScratchStack& local() {
+		static thread_local ScratchStack stack{ defaultSize,
+			std::pmr::get_default_resource() };
+		return stack;
+	}
+
+	std::size_t used() const {
+		return static_cast<std::size_t>(top - begin);
+	}
+
+	std::size_t capacity() const {
+		return size;
+	}
+
+	// the region is one chunk, every block that didn't fit another
+	ResourceStats stats() const override {
+		ResourceStats s;
+		s.bytesInUse = used() + largeBytes;
+		s.bytesReserved = (begin ? size : 0) + largeBytes;
+		s.chunks = (begin ? 1 : 0) + largeBlocks;
+		return s;
+	}
+
+private:
+	void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+		if (begin == nullptr) {
+			begin = top = static_cast<std::byte*>(
+				upstream->allocate(size, alignof(std::max_align_t)));
+			end = begin + size;
+		}
+		void* p = top;
+		std::size_t space = static_cast<std::size_t>(end - top);
+		if (std::align(alignment, bytes, p, space)) {
+			top = static_cast<std::byte*>(p) + bytes;
+			return p;
+		}
+		// too big for what is left, don't fail but go upstream:
+		void* ret = upstream->allocate(bytes, alignment);
+		largeBytes += bytes;
+		++largeBlocks;
+		return ret;
+	}
+
+	// only the most recent block really moves the top back, all others are
+	// freed when their Scope ends
+	void do_deallocate(void* ptr, std::size_t bytes, std::size_t alignment)
+		override {
+		std::byte* p = static_cast<std::byte*>(ptr);
+		if (p < begin || p >= end) {
+			upstream->deallocate(ptr, bytes, alignment);
+			largeBytes -= bytes;
+			--largeBlocks;
+		}
+		else if (p + bytes == top) {
+			top = p;
+		}
+	}
+
+	bool do_is_equal(const std::pmr::memory_resource& other) const noexcept
+		override {
+		return this == &other;
+	}
+};
+
+#endif // SCRATCHSTACK_HPP
@@ -0,0 +1,87 @@
+#ifndef STATICALLOCATOR_HPP
+#define STATICALLOCATOR_HPP
+
+#include <memory>       // for std::uses_allocator_v and std::allocator_arg
+#include <new>
+#include <type_traits>
+#include <utility>      // for std::forward()
+#include <cstddef>
+
+// The non-polymorphic twin of std::pmr::polymorphic_allocator: it knows the
+// concrete type of its resource, so with a final resource (Arena, Pool,
+// StaticArena, ...) the compiler can see through the allocate() call and
+// inline it instead of going through the vtable.
+//
+// Like polymorphic_allocator it passes itself on to elements that take
+// an allocator (e.g. strings using a static_allocator), so a vector and
+// its strings share the resource. std::pair is not taken apart, so
+// map nodes don't propagate it to their members.
+template<typename T, typename Resource>
+class static_allocator
+{
+	static_assert(std::is_final_v<Resource>,
+		"static_allocator needs a final resource type to devirtualize");
+
+private:
+	Resource* res;
+
+public:
+	using value_type = T;
+
+	static_allocator(Resource* r) noexcept   // implicit, like polymorphic_allocator
+		: res{ r } {
+	}
+
+	template<typename U>
+	static_allocator(const static_allocator<U, Resource>& other) noexcept
+		: res{ other.resource() } {
+	}
+
+	[[nodiscard]]
+	T* allocate(std::size_t n) {
+		return static_cast<T*>(res->allocate(n * sizeof(T), alignof(T)));
+	}
+
+	void deallocate(T* p, std::size_t n) noexcept {
+		res->deallocate(p, n * sizeof(T), alignof(T));
+	}
+
+	// uses-allocator construction, as done by polymorphic_allocator
+	template<typename U, typename... Args>
+	void construct(U* p, Args&&... args) {
+		if constexpr (!std::uses_allocator_v<U, static_allocator>) {
+			::new (static_cast<void*>(p)) U(std::forward<Args>(args)...);
+		}
+		else if constexpr (std::is_constructible_v<U, std::allocator_arg_t,
+			const static_allocator&, Args...>) {
+			::new (static_cast<void*>(p)) U(std::allocator_arg, *this,
+				std::forward<Args>(args)...);
+		}
+		else {
+			::new (static_cast<void*>(p)) U(std::forward<Args>(args)..., *this);
+		}
+	}
+
+	Resource* resource() const noexcept {
+		return res;
+	}
+
+	// copies of containers keep using the same resource
+	static_allocator select_on_container_copy_construction() const {
+		return *this;
+	}
+};
+
+template<typename T, typename U, typename Resource>
+bool operator== (const static_allocator<T, Resource>& a,
+	const static_allocator<U, Resource>& b) noexcept {
+	return a.resource() == b.resource();
+}
+
+template<typename T, typename U, typename Resource>
+bool operator!= (const static_allocator<T, Resource>& a,
+	const static_allocator<U, Resource>& b) noexcept {
+	return !(a == b);
+}
+
+#endif // STATICALLOCATOR_HPP
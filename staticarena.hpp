@@ -0,0 +1,97 @@
+#ifndef STATICARENA_HPP
+#define STATICARENA_HPP
+
+#include <memory_resource>
+#include <new>       // for std::bad_alloc
+#include <cstddef>   // for std::byte and std::max_align_t
+#include <cstdint>   // for std::uintptr_t
+#include "introspect.hpp"
+
+// A bump allocator that owns its N bytes, replacing the pair of
+// std::array<std::byte, N> and monotonic_buffer_resource. Code that knows
+// the type calls the inline allocate()/deallocate() below directly, no
+// virtual call and with N known at compile time; everybody else uses it as
+// a plain memory_resource. There is no upstream: running out throws
+// bad_alloc, like a monotonic_buffer_resource on null_memory_resource().
+template<std::size_t N, std::size_t Align = alignof(std::max_align_t)>
+class StaticArena final : public introspectable_resource
+{
+	static_assert(N > 0, "StaticArena needs some bytes");
+	static_assert((Align & (Align - 1)) == 0, "Align must be a power of two");
+
+private:
+	alignas(Align) std::byte buf[N];
+	std::size_t used = 0;
+
+public:
+	StaticArena() = default;
+	StaticArena(const StaticArena&) = delete;
+	StaticArena& operator=(const StaticArena&) = delete;
+
+	// hides memory_resource::allocate() for callers that know the type
+	[[nodiscard]]
+	void* allocate(std::size_t bytes, std::size_t alignment = Align) {
+		std::size_t start;
+		if (alignment <= Align) {
+			// buf is Align-aligned, so aligning the offset is enough
+			start = (used + alignment - 1) & ~(alignment - 1);
+		}
+		else {
+			auto addr = reinterpret_cast<std::uintptr_t>(buf + used);
+			start = used + ((alignment - addr % alignment) % alignment);
+		}
+		if (start > N || bytes > N - start) {
+			throw std::bad_alloc{};
+		}
+		used = start + bytes;
+		return buf + start;
+	}
+
+	// only the most recent block is really given back
+	void deallocate(void* p, std::size_t bytes, std::size_t = Align) noexcept {
+		if (static_cast<std::byte*>(p) + bytes == buf + used) {
+			used = static_cast<std::size_t>(static_cast<std::byte*>(p) - buf);
+		}
+	}
+
+	void release() noexcept {
+		used = 0;
+	}
+
+	static constexpr std::size_t capacity() {
+		return N;
+	}
+
+	std::size_t size() const {          // bytes used so far
+		return used;
+	}
+
+	std::size_t remaining() const {
+		return N - used;
+	}
+
+	ResourceStats stats() const override {
+		ResourceStats s;
+		s.bytesInUse = used;
+		s.bytesReserved = N;
+		s.chunks = 1;
+		return s;
+	}
+
+private:
+	void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+		return allocate(bytes, alignment);
+	}
+
+	void do_deallocate(void* p, std::size_t bytes, std::size_t alignment)
+		override {
+		deallocate(p, bytes, alignment);
+	}
+
+	bool do_is_equal(const std::pmr::memory_resource& other) const noexcept
+		override {
+		return this == &other;
+	}
+};
+
+#endif // STATICARENA_HPP
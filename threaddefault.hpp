@@ -0,0 +1,58 @@
+#ifndef THREADDEFAULT_HPP
+#define THREADDEFAULT_HPP
+
+#include <memory_resource>
+
+// A default memory resource per thread. std::pmr::set_default_resource()
+// changes it for the whole process: other threads that allocate at the
+// same time suddenly use (and contend on) the new resource as well. The
+// in-tree resources and helpers take get_thread_default() as their
+// default upstream instead, and a worker thread routes them to its own
+// arena with
+//
+//   Arena arena{ 100000 };
+//   scoped_default_resource guard{ &arena };
+//   std::pmr::vector<std::pmr::string> coll{ get_thread_default() };
+//
+// Without an override it is the process default. Containers constructed
+// without a resource still get the process default: a forwarding
+// resource set as that would free memory into whatever the freeing
+// thread's default is at that time, not where it came from.
+
+namespace threaddefault_detail {
+inline thread_local std::pmr::memory_resource* current = nullptr;
+}
+
+inline std::pmr::memory_resource* get_thread_default() noexcept {
+	std::pmr::memory_resource* r = threaddefault_detail::current;
+	return r != nullptr ? r : std::pmr::get_default_resource();
+}
+
+// nullptr returns the thread to the process default, returns the
+// previous override (nullptr if there was none)
+inline std::pmr::memory_resource* set_thread_default(std::pmr::memory_resource* r) noexcept {
+	std::pmr::memory_resource* old = threaddefault_detail::current;
+	threaddefault_detail::current = r;
+	return old;
+}
+
+// overrides the default of the calling thread for its lifetime
+class scoped_default_resource
+{
+private:
+	std::pmr::memory_resource* old;
+
+public:
+	explicit scoped_default_resource(std::pmr::memory_resource* r) noexcept
+		: old{ set_thread_default(r) } {
+	}
+
+	~scoped_default_resource() {
+		set_thread_default(old);
+	}
+
+	scoped_default_resource(const scoped_default_resource&) = delete;
+	scoped_default_resource& operator=(const scoped_default_resource&) = delete;
+};
+
+#endif // THREADDEFAULT_HPP
@@ -0,0 +1,96 @@
+#ifndef TRACKER_HPP
+#define TRACKER_HPP
+
+#include <iostream>
+#include <string>
+#include <utility>   // for std::move()
+#include <memory_resource>
+#include <atomic>
+#include "introspect.hpp"
+#include "threaddefault.hpp"
+
+// Prints every allocation and deallocation that passes through it on its
+// way to upstream, to std::cout unless told otherwise. Upstream is the type of that resource, as for
+// BasicArena, Tracker takes any memory_resource.
+template<typename Upstream>
+class BasicTracker final : public introspectable_resource
+{
+private:
+	Upstream* upstream;
+	std::string prefix{};
+	std::ostream* out = &std::cout;
+	// atomic, so a tracker above a synchronized pool can be shared by threads
+	std::atomic<std::size_t> liveBytes{ 0 };
+	std::atomic<std::size_t> liveBlocks{ 0 };
+
+public:
+	// we wrap the passed or default resource
+	explicit BasicTracker(Upstream* us = get_thread_default())
+		: upstream{ us } {
+	}
+
+	explicit BasicTracker(std::string p,
+		Upstream* us = get_thread_default())
+		: upstream{ us }, prefix{ std::move(p) } {
+	}
+
+	BasicTracker(std::string p, Upstream* us, std::ostream& os)
+		: upstream{ us }, prefix{ std::move(p) }, out{ &os } {
+	}
+
+	// hides memory_resource::allocate() for callers that know the type
+	[[nodiscard]]
+	void* allocate(std::size_t bytes,
+		std::size_t alignment = alignof(std::max_align_t)) {
+		*out << prefix << " allocate " << bytes << " Bytes\n";
+		void* ret = upstream->allocate(bytes, alignment);
+		liveBytes.fetch_add(bytes, std::memory_order_relaxed);
+		liveBlocks.fetch_add(1, std::memory_order_relaxed);
+		return ret;
+	}
+
+	void deallocate(void* ptr, std::size_t bytes,
+		std::size_t alignment = alignof(std::max_align_t)) {
+		*out << prefix << " deallocate " << bytes << " Bytes\n";
+		upstream->deallocate(ptr, bytes, alignment);
+		liveBytes.fetch_sub(bytes, std::memory_order_relaxed);
+		liveBlocks.fetch_sub(1, std::memory_order_relaxed);
+	}
+
+	Upstream* upstream_resource() const {
+		return upstream;
+	}
+
+	// what passed through and was not given back yet, the tracker itself
+	// holds nothing (introspect() upstream for what that holds)
+	ResourceStats stats() const override {
+		ResourceStats s;
+		s.bytesInUse = s.bytesReserved = liveBytes.load(std::memory_order_relaxed);
+		s.chunks = liveBlocks.load(std::memory_order_relaxed);
+		return s;
+	}
+
+private:
+	void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+		return allocate(bytes, alignment);
+	}
+
+	void do_deallocate(void* ptr, std::size_t bytes, std::size_t alignment)
+		override {
+		deallocate(ptr, bytes, alignment);
+	}
+
+	/* Determines if one polymorphic memory resource object can deallocate
+	   memory allocated by another */
+	bool do_is_equal(const std::pmr::memory_resource& other) const noexcept
+		override {
+		if (this == &other) return true;
+		auto op = dynamic_cast<const BasicTracker*>(&other);
+		return op != nullptr && op->prefix == prefix
+			&& upstream->is_equal(other);
+	}
+};
+
+using Tracker = BasicTracker<std::pmr::memory_resource>;
+
+#endif // TRACKER_HPP
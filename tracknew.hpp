@@ -1,25 +1,71 @@
 #ifndef TRACKNEW_HPP
 #define TRACKNEW_HPP
 
-#include <new>       // for std::align_val_t
+#include <new>       // for std::align_val_t and std::bad_alloc
 #include <cstdio>    // for printf()
 #include <cstdlib>   // for malloc() and aligned_alloc()
+#include <atomic>
 #ifdef _MSC_VER
 #include <malloc.h>  // for _aligned_malloc() and _aligned_free()
 #endif
 
 class TrackNew {
 private:
-	static inline int numMalloc = 0;    // num malloc calls
-	static inline size_t sumSize = 0;   // bytes allocated so far
+	// atomic, threads of a benchmark allocate at once
+	static inline std::atomic<int> numMalloc{ 0 };    // num malloc calls
+	static inline std::atomic<size_t> sumSize{ 0 };   // bytes allocated so far
 	static inline bool doTrace = false; // tracing enabled
 	static inline bool inNew = false;   // don't track output inside new overloads
+	static inline std::atomic<size_t> curSize{ 0 };   // bytes in use (only sized deletes known)
+	static inline std::atomic<size_t> maxSize{ 0 };   // peak of curSize
 public:
 	static void reset() {               // reset new/memory counters
 		numMalloc = 0;
 		sumSize = 0;
+		curSize = 0;
+		maxSize = 0;
 	}
 
+	static int allocations() {          // counters since the last reset()
+		return numMalloc;
+	}
+	static size_t bytes() {
+		return sumSize;
+	}
+	static size_t peak() {              // most bytes in use at once
+		return maxSize;
+	}
+	static size_t inUse() {             // bytes not given back yet
+		return curSize;
+	}
+
+	// counters over a block of code, unlike reset() this nests
+	class Scope {
+	private:
+		int startMalloc = numMalloc;
+		size_t startSize = sumSize;
+		size_t startCur = curSize;
+		size_t startMax = maxSize;
+	public:
+		Scope() {
+			maxSize = curSize.load();   // peak is measured from here
+		}
+		~Scope() {
+			if (startMax > maxSize) {
+				maxSize = startMax;
+			}
+		}
+		int allocations() const {
+			return numMalloc - startMalloc;
+		}
+		size_t bytes() const {
+			return sumSize - startSize;
+		}
+		size_t peak() const {           // above what was in use at the start
+			return maxSize > startCur ? maxSize - startCur : 0;
+		}
+	};
+
 	static void trace(bool b) {         // enable/disable tracing
 		doTrace = b;
 	}
@@ -27,24 +73,35 @@ public:
 	// implementation of tracked allocation:
 	static void* allocate(std::size_t size, std::size_t align,
 		const char* call) {
-		// track and trace the allocation:
-		++numMalloc;
-		sumSize += size;
 		void* p;
 		if (align == 0) {
-			p = std::malloc(size);
+			p = std::malloc(size > 0 ? size : 1);
 		}
 		else {
 #ifdef _MSC_VER
 			p = _aligned_malloc(size, align);     // Windows API
 #else
-			p = std::aligned_alloc(align, size);  // C++17 API
+			// C++17 API, wants a size that is a multiple of align
+			std::size_t rounded = size > 0 ? (size + align - 1) / align * align : align;
+			p = rounded >= size ? std::aligned_alloc(align, rounded) : nullptr;
 #endif
 		}
+		// operator new must not return nullptr, callers write through it
+		if (p == nullptr) {
+			throw std::bad_alloc{};
+		}
+		// track and trace the allocation:
+		int num = numMalloc.fetch_add(1, std::memory_order_relaxed) + 1;
+		size_t total = sumSize.fetch_add(size, std::memory_order_relaxed) + size;
+		size_t cur = curSize.fetch_add(size, std::memory_order_relaxed) + size;
+		size_t max = maxSize.load(std::memory_order_relaxed);
+		while (cur > max
+			&& !maxSize.compare_exchange_weak(max, cur, std::memory_order_relaxed)) {
+		}
 		if (doTrace) {
 			// DON'T use std::cout here because it might allocate memory
 			// while we are allocating memory (core dump at best)
-			printf("#%d %s ", numMalloc, call);
+			printf("#%d %s ", num, call);
 			printf("(%zu bytes, ", size);
 			if (align > 0) {
 				printf("%zu-byte aligned) ", align);
@@ -52,13 +109,22 @@ public:
 			else {
 				printf("def-aligned) ");
 			}
-			printf("=> %p (total: %zu bytes)\n", (void*)p, sumSize);
+			printf("=> %p (total: %zu bytes)\n", (void*)p, total);
 		}
 		return p;
 	}
 
+	// sized deletes tell how much is given back, unsized ones don't, so
+	// peak() is an upper bound for code using them
+	static void deallocate(std::size_t size) {
+		size_t cur = curSize.load(std::memory_order_relaxed);
+		while (!curSize.compare_exchange_weak(cur, size < cur ? cur - size : 0,
+			std::memory_order_relaxed)) {
+		}
+	}
+
 	static void status() {              // print current state
-		printf("%d allocations for %zu bytes\n", numMalloc, sumSize);
+		printf("%d allocations for %zu bytes\n", numMalloc.load(), sumSize.load());
 	}
 };
 
@@ -88,7 +154,8 @@ void* operator new[](std::size_t size, std::align_val_t align) {
 void operator delete (void* p) noexcept {
 	std::free(p);
 }
-void operator delete (void* p, std::size_t) noexcept {
+void operator delete (void* p, std::size_t size) noexcept {
+	TrackNew::deallocate(size);
 	::operator delete(p);
 }
 void operator delete (void* p, std::align_val_t) noexcept {
@@ -98,8 +165,9 @@ void operator delete (void* p, std::align_val_t) noexcept {
 	std::free(p);      // C++17 API
 #endif
 }
-void operator delete (void* p, std::size_t,
+void operator delete (void* p, std::size_t size,
 	std::align_val_t align) noexcept {
+	TrackNew::deallocate(size);
 	::operator delete(p, align);
 }
 
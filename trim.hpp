@@ -0,0 +1,115 @@
+#ifndef TRIM_HPP
+#define TRIM_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>   // for std::uintptr_t
+#ifdef __linux__
+#include <sys/mman.h>  // for madvise()
+#include <unistd.h>    // for sysconf()
+#endif
+
+// Resources keep what their users gave back for the next request, a
+// long-lived service sits on its historical peak that way. trim() of Pool,
+// AdaptivePool and Arena gives the pages of memory that is entirely free
+// back to the OS with madvise() but keeps the address range: the
+// resource stays intact and the pages come back zeroed, page fault by
+// page fault, when used again. Elsewhere than on Linux trimming does
+// nothing.
+enum class TrimMode {
+	dontNeed,   // MADV_DONTNEED: the pages go at once
+	lazyFree    // MADV_FREE: the kernel takes them when it needs memory,
+	            // cheaper to reuse, but RSS only drops under pressure
+};
+
+// asked once, pages are 16 KiB or 64 KiB on some ARM systems
+inline std::size_t trimPageSize() noexcept {
+#ifdef __linux__
+	static const std::size_t size = [] {
+		long s = sysconf(_SC_PAGESIZE);
+		return s > 0 ? static_cast<std::size_t>(s) : std::size_t{ 4096 };
+	}();
+	return size;
+#else
+	return 4096;
+#endif
+}
+
+// the bytes of the whole pages within [p, p + bytes)
+inline std::size_t wholePages(const void* p, std::size_t bytes) noexcept {
+	std::size_t page = trimPageSize();
+	auto begin = reinterpret_cast<std::uintptr_t>(p);
+	auto first = (begin + page - 1) & ~(page - 1);
+	auto last = (begin + bytes) & ~(page - 1);
+	return last > first ? last - first : 0;
+}
+
+// gives the whole pages within [p, p + bytes) back to the OS, returns
+// their bytes (0 where that isn't possible)
+inline std::size_t trimPages(void* p, std::size_t bytes,
+	TrimMode mode = TrimMode::dontNeed) noexcept {
+	std::size_t size = wholePages(p, bytes);
+	if (size == 0) {
+		return 0;
+	}
+#ifdef __linux__
+	auto first = (reinterpret_cast<std::uintptr_t>(p) + trimPageSize() - 1)
+		& ~(trimPageSize() - 1);
+	void* start = reinterpret_cast<void*>(first);
+#ifdef MADV_FREE
+	if (mode == TrimMode::lazyFree && madvise(start, size, MADV_FREE) == 0) {
+		return size;
+	}
+#endif
+	// no MADV_FREE (before Linux 4.5) or dontNeed:
+	return madvise(start, size, MADV_DONTNEED) == 0 ? size : 0;
+#else
+	(void)mode;
+	return 0;
+#endif
+}
+
+// Trims a resource once it was idle for a while. The resource counts its
+// operations in activity(), poll() (from a timer or the housekeeping loop
+// of a service) trims when that count didn't change for the idle time,
+// once per idle stretch. On a memory pressure signal (e.g. a PSI trigger
+// on /proc/pressure/memory) call trim() of the resource directly.
+// Neither is synchronized with the users of the resource.
+template<typename R>
+class IdleTrimmer
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+private:
+	R& res;
+	Clock::duration idle;
+	TrimMode mode;
+	std::size_t seen;
+	Clock::time_point since;
+	bool trimmed = false;
+
+public:
+	IdleTrimmer(R& r, Clock::duration idleTime, TrimMode m = TrimMode::dontNeed)
+		: res{ r }, idle{ idleTime }, mode{ m }, seen{ r.activity() },
+		  since{ Clock::now() } {
+	}
+
+	// returns the bytes given back
+	std::size_t poll(Clock::time_point now = Clock::now()) {
+		std::size_t a = res.activity();
+		if (a != seen) {
+			seen = a;
+			since = now;
+			trimmed = false;
+			return 0;
+		}
+		if (trimmed || now - since < idle) {
+			return 0;
+		}
+		trimmed = true;
+		return res.trim(mode);
+	}
+};
+
+#endif // TRIM_HPP